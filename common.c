@@ -6,6 +6,7 @@
  */
 
 #include <ctype.h>
+#include <string.h>
 #include <vdr/tools.h>
 #include "common.h"
 
@@ -29,6 +30,72 @@ uint8_t payload(const uint8_t *bufP)
   return 184;
 }
 
+bool ts_sync_valid(const uint8_t *bufP, int lengthP)
+{
+  // Every packet of the payload must start with a sync byte
+  for (int i = 0; i < lengthP; i += TS_SIZE) {
+      if (bufP[i] != TS_SYNC_BYTE)
+         return false;
+      }
+  return true;
+}
+
+int ts_sync_find(const uint8_t *bufP, int lengthP, bool *confirmedP)
+{
+  // The candidates are located via memchr(), which glibc vectorizes with
+  // runtime cpu dispatching, and confirmed by the next two packets. A
+  // candidate too close to the end to be confirmed is returned as such,
+  // the caller keeps it and checks it again once more data is available.
+  const uint8_t *p = bufP, *end = bufP + lengthP;
+  if (confirmedP)
+     *confirmedP = false;
+  while ((p < end) && (p = (const uint8_t *)memchr(p, TS_SYNC_BYTE, end - p)) != NULL) {
+        if (p + 2 * TS_SIZE >= end)
+           return (int)(p - bufP);
+        if ((p[TS_SIZE] == TS_SYNC_BYTE) && (p[2 * TS_SIZE] == TS_SYNC_BYTE)) {
+           if (confirmedP)
+              *confirmedP = true;
+           return (int)(p - bufP);
+           }
+        ++p;
+        }
+  return lengthP;
+}
+
+// Slice-by-8 tables for the MSB first CRC-32/MPEG-2 (poly 0x04C11DB7)
+static struct crc32_tables {
+  uint32_t t[8][256];
+  crc32_tables()
+  {
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t crc = i << 24;
+        for (int j = 0; j < 8; ++j)
+            crc = (crc & 0x80000000) ? ((crc << 1) ^ 0x04C11DB7) : (crc << 1);
+        t[0][i] = crc;
+        }
+    for (int k = 1; k < 8; ++k) {
+        for (int i = 0; i < 256; ++i)
+            t[k][i] = (t[k - 1][i] << 8) ^ t[0][t[k - 1][i] >> 24];
+        }
+  }
+} crc32_table;
+
+uint32_t crc32_mpeg2(const uint8_t *bufP, int lengthP)
+{
+  // A section including its CRC32 field yields zero
+  const uint32_t (*t)[256] = crc32_table.t;
+  uint32_t crc = 0xFFFFFFFF;
+  for (; lengthP >= 8; bufP += 8, lengthP -= 8) {
+      uint32_t a = crc ^ (((uint32_t)bufP[0] << 24) | (bufP[1] << 16) | (bufP[2] << 8) | bufP[3]);
+      uint32_t b = ((uint32_t)bufP[4] << 24) | (bufP[5] << 16) | (bufP[6] << 8) | bufP[7];
+      crc = t[7][a >> 24] ^ t[6][(a >> 16) & 0xFF] ^ t[5][(a >> 8) & 0xFF] ^ t[4][a & 0xFF] ^
+            t[3][b >> 24] ^ t[2][(b >> 16) & 0xFF] ^ t[1][(b >> 8) & 0xFF] ^ t[0][b & 0xFF];
+      }
+  while (lengthP-- > 0)
+        crc = (crc << 8) ^ t[0][(crc >> 24) ^ *bufP++];
+  return crc;
+}
+
 const char *id_pid(const u_short pidP)
 {
   for (int i = 0; i < SECTION_FILTER_TABLE_SIZE; ++i) {
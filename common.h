@@ -142,6 +142,9 @@ public:
 
 uint16_t ts_pid(const uint8_t *bufP);
 uint8_t payload(const uint8_t *bufP);
+bool ts_sync_valid(const uint8_t *bufP, int lengthP);
+int ts_sync_find(const uint8_t *bufP, int lengthP, bool *confirmedP = NULL);
+uint32_t crc32_mpeg2(const uint8_t *bufP, int lengthP);
 const char *id_pid(const u_short pidP);
 char *StripTags(char *strP);
 char *SkipZeroes(const char *strP);
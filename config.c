@@ -16,11 +16,17 @@ cSatipConfig::cSatipConfig(void)
   debugModeM(DbgNormal),
   ciExtensionM(0),
   frontendReuseM(1),
+  streamSharingM(1),
+  dropUnrequestedM(0),
+  sectionRefreshM(0),
+  eventLoopsM(0),
+  idleReleaseM(300),
   eitScanM(1),
   useBytesM(1),
   portRangeStartM(0),
   portRangeStopM(0),
   transportModeM(eTransportModeUnicast),
+  assignPolicyM(eAssignPolicyLoad),
   detachedModeM(false),
   disableServerQuirksM(false),
   useSingleModelServersM(false),
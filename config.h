@@ -18,11 +18,17 @@ private:
   unsigned int debugModeM;
   unsigned int ciExtensionM;
   unsigned int frontendReuseM;
+  unsigned int streamSharingM;
+  unsigned int dropUnrequestedM;
+  unsigned int sectionRefreshM;
+  unsigned int eventLoopsM;
+  unsigned int idleReleaseM;
   unsigned int eitScanM;
   unsigned int useBytesM;
   unsigned int portRangeStartM;
   unsigned int portRangeStopM;
   unsigned int transportModeM;
+  unsigned int assignPolicyM;
   bool detachedModeM;
   bool disableServerQuirksM;
   bool useSingleModelServersM;
@@ -45,6 +51,11 @@ public:
     eTransportModeRtpOverTcp,
     eTransportModeCount
   };
+  enum eAssignPolicy {
+    eAssignPolicyFirst = 0,
+    eAssignPolicyLoad,
+    eAssignPolicyCount
+  };
   enum eDebugMode {
     DbgNormal            = 0,
     DbgCallStack         = (1U << 0),
@@ -76,6 +87,11 @@ public:
   bool IsDebugMode(eDebugMode modeP) const { return (debugModeM & modeP); }
   unsigned int GetCIExtension(void) const { return ciExtensionM; }
   unsigned int GetFrontendReuse(void) const { return frontendReuseM; }
+  unsigned int GetStreamSharing(void) const { return streamSharingM; }
+  unsigned int GetDropUnrequested(void) const { return dropUnrequestedM; }
+  unsigned int GetSectionRefresh(void) const { return sectionRefreshM; }
+  unsigned int GetEventLoops(void) const { return eventLoopsM; }
+  unsigned int GetIdleRelease(void) const { return idleReleaseM; }
   int GetCICAM(unsigned int indexP) const;
   unsigned int GetEITScan(void) const { return eitScanM; }
   unsigned int GetUseBytes(void) const { return useBytesM; }
@@ -83,6 +99,7 @@ public:
   bool IsTransportModeUnicast(void) const { return (transportModeM == eTransportModeUnicast); }
   bool IsTransportModeRtpOverTcp(void) const { return (transportModeM == eTransportModeRtpOverTcp); }
   bool IsTransportModeMulticast(void) const { return (transportModeM == eTransportModeMulticast); }
+  unsigned int GetAssignPolicy(void) const { return assignPolicyM; }
   bool GetDetachedMode(void) const { return detachedModeM; }
   bool GetDisableServerQuirks(void) const { return disableServerQuirksM; }
   bool GetUseSingleModelServers(void) const { return useSingleModelServersM; }
@@ -98,10 +115,16 @@ public:
   void SetDebugMode(unsigned int modeP) { debugModeM = (modeP & DbgModeMask); }
   void SetCIExtension(unsigned int onOffP) { ciExtensionM = onOffP; }
   void SetFrontendReuse(unsigned int onOffP) { frontendReuseM = onOffP; }
+  void SetStreamSharing(unsigned int onOffP) { streamSharingM = onOffP; }
+  void SetDropUnrequested(unsigned int onOffP) { dropUnrequestedM = onOffP; }
+  void SetSectionRefresh(unsigned int secondsP) { sectionRefreshM = secondsP; }
+  void SetEventLoops(unsigned int countP) { eventLoopsM = countP; }
+  void SetIdleRelease(unsigned int secondsP) { idleReleaseM = secondsP; }
   void SetCICAM(unsigned int indexP, int cicamP);
   void SetEITScan(unsigned int onOffP) { eitScanM = onOffP; }
   void SetUseBytes(unsigned int onOffP) { useBytesM = onOffP; }
   void SetTransportMode(unsigned int transportModeP) { transportModeM = transportModeP; }
+  void SetAssignPolicy(unsigned int policyP) { assignPolicyM = policyP; }
   void SetDetachedMode(bool onOffP) { detachedModeM = onOffP; }
   void SetDisableServerQuirks(bool onOffP) { disableServerQuirksM = onOffP; }
   void SetUseSingleModelServers(bool onOffP) { useSingleModelServersM = onOffP; }
@@ -6,52 +6,68 @@
  */
 #include <string>     // std::string
 #include <vector>     // std::vector
-#include <algorithm>  // std::min()
+#include <set>        // std::set
+#include <algorithm>  // std::min(), std::find()
 #include <vdr/menu.h> // cRecordControl
 
 #include "config.h"
 #include "discover.h"
 #include "log.h"
 #include "param.h"
+#include "tunecache.h"
 #include "device.h"
 
 std::vector<cSatipDevice*> SatipDevices;
 
-cMutex cSatipDevice::SetChannelMtx = cMutex();
+cMutex cSatipDevice::TuningLocksMtx;
+cMutex cSatipDevice::StreamBrokerMtx;
+std::map<std::string, cMutex> cSatipDevice::TuningLocks;
 
 cSatipDevice::cSatipDevice(unsigned int DeviceIndex) :
   deviceIndex(DeviceIndex),
   bytesDelivered(0),
   dvrIsOpen(false),
   checkTsBufferM(false),
+  resyncTsBufferM(false),
   currentChannel(),
+  tsBuffer(nullptr),
+  dataReady(),
+  tuner(nullptr),
   SectionFilterHandler(nullptr),
+  resourcesMtx(),
+  lastUse(),
   ReadyTimeout(0),
-  tunerLocked()
+  tunerLocked(),
+  streamHost(nullptr),
+  streamGuests(),
+  switching(false),
+  zapMtx(),
+  resumePending(false)
 {
   size_t bufsize = SATIP_BUFFER_SIZE;
   bufsize -= (bufsize % TS_SIZE);
   info("Creating device CardIndex=%d DeviceNumber=%d [device %d]", CardIndex(), DeviceNumber(), deviceIndex);
-  tsBuffer = new cRingBufferLinear(bufsize + 1, TS_SIZE);
-  if (tsBuffer) {
-     tsBuffer->SetTimeouts(10, 10);
-     tsBuffer->SetIoThrottle();
-     tuner = new cSatipTuner(*this, tsBuffer->Free());
-
-     // Start section handler
-     SectionFilterHandler = new cSatipSectionFilterHandler(deviceIndex, bufsize + 1);
-     StartSectionHandler();
-     }
+  // The tuner lives as long as the device, only its sockets and the
+  // buffers are allocated on demand
+  tuner = new cSatipTuner(*this, bufsize);
+  // Start section handler, its buffer is allocated along with the tuner sockets
+  SectionFilterHandler = new cSatipSectionFilterHandler(deviceIndex, bufsize + 1);
+  StartSectionHandler();
 }
 
 cSatipDevice::~cSatipDevice() {
   dbg_funcname("%s [device %d]", __PRETTY_FUNCTION__, deviceIndex);
   // Release immediately any pending conditional wait
   tunerLocked.Broadcast();
+  // No more data arrives for the section handler
+  tuner->Deactivate();
   // Stop section handler
   if (SectionFilterHandler)
      StopSectionHandler();
   DELETE_POINTER(SectionFilterHandler);
+  // Nobody may use our session anymore
+  LeaveStream();
+  HandOverGuests(false);
   DELETE_POINTER(tuner);
   DELETE_POINTER(tsBuffer);
 }
@@ -71,6 +87,12 @@ void cSatipDevice::Shutdown(void) {
      device->CloseDvr();
 }
 
+void cSatipDevice::Housekeeping(void) {
+  dbg_funcname_ext("%s", __PRETTY_FUNCTION__);
+  for(auto device:SatipDevices)
+     device->ReleaseResources();
+}
+
 size_t cSatipDevice::Count(void) {
   return SatipDevices.size();
 }
@@ -124,11 +146,13 @@ cString cSatipDevice::GetGeneralInformation(void)
 {
   dbg_funcname_ext("%s [device %d]", __PRETTY_FUNCTION__, deviceIndex);
   LOCK_CHANNELS_READ;
-  return cString::sprintf("SAT>IP device: %d\nCardIndex: %d\nStream: %s\nSignal: %s\nStream bitrate: %s\n%sChannel: %s\n",
+  return cString::sprintf("SAT>IP device: %d\nCardIndex: %d\nStream: %s\nSignal: %s\nStream bitrate: %s\nLock wait: %s\nDropped packets: %s\n%sChannel: %s\n",
                           deviceIndex, CardIndex(),
-                          tuner ? *tuner->GetInformation() : "",
-                          tuner ? *tuner->GetSignalStatus() : "",
-                          tuner ? *tuner->GetTunerStatistic() : "",
+                          *tuner->GetInformation(),
+                          *tuner->GetSignalStatus(),
+                          *tuner->GetTunerStatistic(),
+                          *tuner->GetLockWaitStatistic(),
+                          *tuner->GetDropStatistic(),
                           *GetBufferStatistic(),
                           *Channels->GetByNumber(cDevice::CurrentChannel())->ToText());
 }
@@ -136,7 +160,7 @@ cString cSatipDevice::GetGeneralInformation(void)
 cString cSatipDevice::GetPidsInformation(void)
 {
   dbg_funcname_ext("%s [device %d]", __PRETTY_FUNCTION__, deviceIndex);
-  return GetPidStatistic();
+  return cString::sprintf("%s%s", *GetPidStatistic(), *tuner->GetContinuityStatistic());
 }
 
 cString cSatipDevice::GetFiltersInformation(void)
@@ -160,10 +184,10 @@ cString cSatipDevice::GetInformation(unsigned int pageP)
          s = GetFiltersInformation();
          break;
     case SATIP_DEVICE_INFO_PROTOCOL:
-         s = tuner ? *tuner->GetInformation() : "";
+         s = tuner->GetInformation();
          break;
     case SATIP_DEVICE_INFO_BITRATE:
-         s = tuner ? *tuner->GetTunerStatistic() : "";
+         s = tuner->GetTunerStatistic();
          break;
     default:
          s = cString::sprintf("%s%s%s",
@@ -213,8 +237,9 @@ bool cSatipDevice::SignalStats(int &Valid, double *Strength, double *Cnr, double
 {
   dbg_funcname_ext("%s [device %d]", __PRETTY_FUNCTION__, deviceIndex);
   Valid = DTV_STAT_VALID_NONE;
-  if (Strength && tuner) {
-     *Strength =  tuner->SignalStrengthDBm();
+  cSatipTuner* t = ActiveTuner();
+  if (Strength && t) {
+     *Strength =  t->SignalStrengthDBm();
      if (*Strength < -18.0) /* valid: -71.458 .. -18.541, invalid: 0.0 */
         Valid |= DTV_STAT_VALID_STRENGTH;
      }
@@ -228,13 +253,15 @@ bool cSatipDevice::SignalStats(int &Valid, double *Strength, double *Cnr, double
 int cSatipDevice::SignalStrength(void) const
 {
   dbg_funcname_ext("%s [device %d]", __PRETTY_FUNCTION__, deviceIndex);
-  return (tuner ? tuner->SignalStrength() : -1);
+  cSatipTuner* t = ActiveTuner();
+  return (t ? t->SignalStrength() : -1);
 }
 
 int cSatipDevice::SignalQuality(void) const
 {
   dbg_funcname_ext("%s [device %d]", __PRETTY_FUNCTION__, deviceIndex);
-  return (tuner ? tuner->SignalQuality() : -1);
+  cSatipTuner* t = ActiveTuner();
+  return (t ? t->SignalQuality() : -1);
 }
 
 bool cSatipDevice::ProvidesSource(int sourceP) const
@@ -333,7 +360,8 @@ const cChannel *cSatipDevice::GetCurrentlyTunedTransponder(void) const
 
 bool cSatipDevice::IsTunedToTransponder(const cChannel *channelP) const
 {
-  if (tuner && !tuner->IsTuned())
+  cSatipTuner* t = ActiveTuner();
+  if (!t || !t->IsTuned())
      return false;
   if ((currentChannel.Source() != channelP->Source()) || (currentChannel.Transponder() != channelP->Transponder()))
      return false;
@@ -345,44 +373,117 @@ bool cSatipDevice::MaySwitchTransponder(const cChannel *channelP) const
   return cDevice::MaySwitchTransponder(channelP);
 }
 
+cMutex* cSatipDevice::GetTuningLock(const char* address) {
+  cMutexLock MutexLock(&TuningLocksMtx);
+  return &TuningLocks[address ? address : ""]; // std::map never moves its elements
+}
+
 bool cSatipDevice::SetChannelDevice(const cChannel* channel, bool liveView)
 {
-  cMutexLock MutexLock(&SetChannelMtx);  // Global lock to prevent any simultaneous zapping
   dbg_chan_switch("%s (%d, %d) [device %d]",
       __PRETTY_FUNCTION__, channel ? channel->Number() : -1, liveView, deviceIndex);
 
-  if (tuner == nullptr) {
+  // a pending hand over is superseded by this channel
+  resumePending = false;
+  cMutexLock ZapLock(&zapMtx);
+
+  if (not AcquireResources()) {
      dbg_chan_switch("%s [device %d] -> false (no tuner)", __PRETTY_FUNCTION__, deviceIndex);
      return false;
      }
 
-  if (channel) {
-     std::string params = GetTransponderUrlParameters(channel);
-     if (params.empty()) {
-        error("Unrecognized channel parameters: %s [device %d]", channel->Parameters(), deviceIndex);
-        return false;
-        }
+  StreamBrokerMtx.Lock();
+  cSatipDevice* host = streamHost;
+  StreamBrokerMtx.Unlock();
+  if (channel && host && host->IsTunedToTransponder(channel)) {
+     // still on the transponder of the shared session
+     currentChannel = *channel;
+     return true;
+     }
+
+  StreamBrokerMtx.Lock();
+  switching = true;
+  StreamBrokerMtx.Unlock();
+
+  bool sameTransponder = channel and IsTunedToTransponder(channel);
+  if (not sameTransponder)
+     HandOverGuests(true);
+  LeaveStream();
+  // the sections are cached again once the new stream is tuned
+  if (SectionFilterHandler and not sameTransponder)
+     SectionFilterHandler->SetTransponder(0, 0);
+  bool result = JoinStream(channel);
+  if (result and SectionFilterHandler)
+     SectionFilterHandler->SetTransponder(channel->Source(), channel->Transponder());
+  result = result || TuneChannel(channel);
+
+  StreamBrokerMtx.Lock();
+  switching = false;
+  StreamBrokerMtx.Unlock();
+  return result;
+}
 
+bool cSatipDevice::TuneChannel(const cChannel* channel, bool wait)
+{
+  if (channel) {
      auto discover = cSatipDiscover::GetInstance();
-     auto server = discover->AssignServer(deviceIndex,
-                                          channel->Source(),
-                                          channel->Transponder(),
-                                          cDvbTransponderParameters(channel->Parameters()).System());
-
-     if (!server) {
-        dbg_chan_switch("%s No server for %s [device %d]",
-            __PRETTY_FUNCTION__, *channel->ToText(), deviceIndex);
-        return false;
-        }
 
-     serverString = *discover->GetServerString(server);
+     for(int attempt = 0; attempt < eTuningAttempts; attempt++) {
+        cSatipTuneDescriptor tune;
+        if (!cSatipTuneCache::GetInstance()->Get(channel, tune)) {
+           error("Unrecognized channel parameters: %s [device %d]", channel->Parameters(), deviceIndex);
+           return false;
+           }
+
+        // Zapping is serialized per SAT>IP server only: every server that might be
+        // assigned is locked, in address order to avoid deadlocks between devices.
+        std::set<std::string> addresses;
+        for(auto s:tune.servers)
+           addresses.insert(*discover->GetServerAddress(s));
+        std::vector<cMutex*> locks;
+        for(auto& a:addresses)
+           locks.push_back(GetTuningLock(a.c_str()));
+        for(auto l:locks)
+           l->Lock();
+
+        auto server = discover->AssignServer(deviceIndex,
+                                             channel->Source(),
+                                             channel->Transponder(),
+                                             tune.system,
+                                             tune.servers,
+                                             tune.serversState);
+        cMutex* lock = server ? GetTuningLock(*discover->GetServerAddress(server)) : nullptr;
+        for(auto l:locks)
+           if (l != lock)
+              l->Unlock();
+
+        if (!server) {
+           dbg_chan_switch("%s No server for %s [device %d]",
+               __PRETTY_FUNCTION__, *channel->ToText(), deviceIndex);
+           return false;
+           }
+
+        if (std::find(locks.begin(), locks.end(), lock) == locks.end()) {
+           // the server list changed meanwhile and the assigned server isn't locked
+           dbg_chan_switch("%s Server list changed, retrying %s [device %d]",
+               __PRETTY_FUNCTION__, *channel->ToText(), deviceIndex);
+           continue;
+           }
 
-     if (tuner->SetSource(server, channel->Transponder(), params.c_str(), deviceIndex)) {
+        serverString = *discover->GetServerString(server);
+
+        // set beforehand, SetChannelTuned() derives the section cache key from it
         currentChannel = *channel;
-        // Wait for actual channel tuning to prevent simultaneous frontend allocation failures
-        tunerLocked.TimedWait(SetChannelMtx, eTuningTimeoutMs);
+        if (tuner->SetSource(server, channel->Transponder(), tune.query.c_str(), deviceIndex)) {
+           // Wait for actual channel tuning to prevent simultaneous frontend allocation failures
+           if (wait)
+              tunerLocked.TimedWait(*lock, eTuningTimeoutMs);
+           }
+        lock->Unlock();
         return true;
         }
+     error("Unable to assign a server for %s [device %d]", *channel->ToText(), deviceIndex);
+     return false;
      }
   else {
      tuner->SetSource(nullptr, 0, nullptr, deviceIndex);
@@ -391,9 +492,161 @@ bool cSatipDevice::SetChannelDevice(const cChannel* channel, bool liveView)
   return true;
 }
 
+bool cSatipDevice::AcquireResources(void)
+{
+  cMutexLock MutexLock(&resourcesMtx);
+  lastUse.Set();
+  if (tsBuffer)
+     return true;
+  dbg_funcname("%s [device %d]", __PRETTY_FUNCTION__, deviceIndex);
+  size_t bufsize = SATIP_BUFFER_SIZE;
+  bufsize -= (bufsize % TS_SIZE);
+  tsBuffer = new cRingBufferLinear(bufsize + 1, TS_SIZE);
+  if (not tsBuffer)
+     return false;
+  tsBuffer->SetTimeouts(10, 0);
+  tsBuffer->SetIoThrottle();
+  if (SectionFilterHandler)
+     SectionFilterHandler->Activate();
+  // the tuner keeps its pids across a release
+  return tuner->Activate();
+}
+
+void cSatipDevice::ReleaseResources(void)
+{
+  unsigned int timeout = SatipConfig.GetIdleRelease();
+  if (not timeout)
+     return;
+  // checked before locking: VDR calls SetPid() with its receiver lock held.
+  // An attach meanwhile renews lastUse and thus postpones the release.
+  bool busy = dvrIsOpen or Receiving();
+  cMutexLock MutexLock(&resourcesMtx);
+  if (not tsBuffer)
+     return;
+  // a handed over guest is resumed by its own tuner
+  StreamBrokerMtx.Lock();
+  bool shared = streamHost or not streamGuests.empty() or switching or resumePending;
+  StreamBrokerMtx.Unlock();
+  if (busy or shared or not tuner->IsIdle()) {
+     lastUse.Set();
+     return;
+     }
+  if (lastUse.Elapsed() < timeout * 1000ULL)
+     return;
+  info("Releasing idle device resources [device %d]", deviceIndex);
+  // no more data arrives once the tuner sockets are closed
+  tuner->Deactivate();
+  if (SectionFilterHandler)
+     SectionFilterHandler->Deactivate();
+  DELETE_POINTER(tsBuffer);
+}
+
+cSatipTuner* cSatipDevice::ActiveTuner(void) const
+{
+  cMutexLock MutexLock(&StreamBrokerMtx);
+  return streamHost ? streamHost->tuner : tuner;
+}
+
+void cSatipDevice::SetGuestPid(int pid, int type, bool on)
+{
+  // our own tuner keeps the pids as well for the time after sharing
+  cMutexLock MutexLock(&StreamBrokerMtx);
+  if (streamHost)
+     streamHost->tuner->SetPid(pid, type, on, deviceIndex);
+}
+
+bool cSatipDevice::JoinStream(const cChannel* channel)
+{
+  if (not channel or not SatipConfig.GetStreamSharing())
+     return false;
+  // the CI parameters belong to a single session
+  if (SatipConfig.GetCIExtension() and channel->Ca())
+     return false;
+
+  cMutexLock MutexLock(&StreamBrokerMtx);
+  if (not streamGuests.empty())
+     return false;
+  for(auto device:SatipDevices) {
+     if (device == this or device->streamHost or device->switching or not device->tuner->IsTuned())
+        continue;
+     const cChannel& c = device->currentChannel;
+     if ((c.Source() != channel->Source()) or (c.Transponder() != channel->Transponder()) or strcmp(c.Parameters(), channel->Parameters()))
+        continue;
+     dbg_chan_switch("%s Sharing the stream of device %d for %s [device %d]",
+         __PRETTY_FUNCTION__, device->deviceIndex, *channel->ToText(), deviceIndex);
+     device->streamGuests.push_back(this);
+     device->tuner->Subscribe(this);
+     for(auto pid:tuner->GetPids())
+        device->tuner->SetPid(pid, ptOther, true, deviceIndex);
+     tuner->Release();
+     streamHost = device;
+     serverString = device->serverString;
+     currentChannel = *channel;
+     return true;
+     }
+  return false;
+}
+
+void cSatipDevice::LeaveStream(void)
+{
+  cMutexLock MutexLock(&StreamBrokerMtx);
+  if (streamHost) {
+     dbg_chan_switch("%s Leaving the stream of device %d [device %d]", __PRETTY_FUNCTION__, streamHost->deviceIndex, deviceIndex);
+     auto& guests = streamHost->streamGuests;
+     guests.erase(std::remove(guests.begin(), guests.end(), this), guests.end());
+     streamHost->tuner->Unsubscribe(this);
+     streamHost = nullptr;
+     }
+}
+
+void cSatipDevice::HandOverGuests(bool retune)
+{
+  std::vector<cSatipDevice*> guests;
+  StreamBrokerMtx.Lock();
+  guests.swap(streamGuests);
+  for(auto g:guests) {
+     tuner->Unsubscribe(g);
+     g->streamHost = nullptr;
+     }
+  if (retune) {
+     // the guests continue with sessions of their own, tuned by their own
+     // tuner threads so that this zap doesn't wait for them
+     for(auto g:guests) {
+        dbg_chan_switch("%s Handing over to device %d [device %d]", __PRETTY_FUNCTION__, g->deviceIndex, deviceIndex);
+        g->resumePending = true;
+        g->tuner->Wakeup();
+        }
+     }
+  StreamBrokerMtx.Unlock();
+}
+
+void cSatipDevice::ResumeStream(void)
+{
+  if (not resumePending)
+     return;
+  cMutexLock ZapLock(&zapMtx);
+  // switching keeps ReleaseResources() off until the tuning is requested
+  StreamBrokerMtx.Lock();
+  switching = resumePending.exchange(false);
+  StreamBrokerMtx.Unlock();
+  if (not switching)
+     return; // VDR has zapped meanwhile
+  cChannel channel = currentChannel;
+  dbg_chan_switch("%s Resuming %s [device %d]", __PRETTY_FUNCTION__, *channel.ToText(), deviceIndex);
+  // called by our own tuner thread, which can't report the tuning meanwhile
+  if (not JoinStream(&channel))
+     TuneChannel(&channel, false);
+  StreamBrokerMtx.Lock();
+  switching = false;
+  StreamBrokerMtx.Unlock();
+}
+
 void cSatipDevice::SetChannelTuned(void)
 {
   dbg_chan_switch("%s () [device %d]", __PRETTY_FUNCTION__, deviceIndex);
+  // Sections received from now on belong to the tuned transponder
+  if (SectionFilterHandler)
+     SectionFilterHandler->SetTransponder(currentChannel.Source(), currentChannel.Transponder());
   // Release immediately any pending conditional wait
   tunerLocked.Broadcast();
 }
@@ -401,11 +654,17 @@ void cSatipDevice::SetChannelTuned(void)
 bool cSatipDevice::SetPid(cPidHandle *handleP, int typeP, bool onP)
 {
   dbg_pids("%s (%d, %d, %d) [device %d]", __PRETTY_FUNCTION__, handleP ? handleP->pid : -1, typeP, onP, deviceIndex);
-  if (tuner && handleP && handleP->pid >= 0 && handleP->pid <= 8191) {
-     if (onP)
+  if (onP)
+     AcquireResources();
+  if (handleP && handleP->pid >= 0 && handleP->pid <= 8191) {
+     if (onP) {
+        SetGuestPid(handleP->pid, typeP, true);
         return tuner->SetPid(handleP->pid, typeP, true);
-     else if (!handleP->used && SectionFilterHandler && !SectionFilterHandler->Exists(handleP->pid))
+        }
+     else if (!handleP->used && SectionFilterHandler && !SectionFilterHandler->Exists(handleP->pid)) {
+        SetGuestPid(handleP->pid, typeP, false);
         return tuner->SetPid(handleP->pid, typeP, false);
+        }
      }
   return true;
 }
@@ -414,9 +673,12 @@ int cSatipDevice::OpenFilter(unsigned short pidP, unsigned char tidP, unsigned c
 {
   dbg_pids("%s (%d, %02X, %02X) [device %d]", __PRETTY_FUNCTION__, pidP, tidP, maskP, deviceIndex);
   if (SectionFilterHandler) {
+     AcquireResources();
      int handle = SectionFilterHandler->Open(pidP, tidP, maskP);
-     if (tuner && (handle >= 0))
+     if (handle >= 0) {
+        SetGuestPid(pidP, ptOther, true);
         tuner->SetPid(pidP, ptOther, true);
+        }
      return handle;
      }
   return -1;
@@ -427,8 +689,8 @@ void cSatipDevice::CloseFilter(int handleP)
   if (SectionFilterHandler) {
      int pid = SectionFilterHandler->GetPid(handleP);
      dbg_pids("%s (%d) [device %d]", __PRETTY_FUNCTION__, pid, deviceIndex);
-     if (tuner)
-        tuner->SetPid(pid, ptOther, false);
+     SetGuestPid(pid, ptOther, false);
+     tuner->SetPid(pid, ptOther, false);
      SectionFilterHandler->Close(handleP);
      }
 }
@@ -436,8 +698,10 @@ void cSatipDevice::CloseFilter(int handleP)
 bool cSatipDevice::OpenDvr(void) {
   dbg_chan_switch("%s [device %d]", __PRETTY_FUNCTION__, deviceIndex);
   bytesDelivered = 0;
-  if (tuner && tsBuffer) {
+  cMutexLock MutexLock(&resourcesMtx);
+  if (AcquireResources()) {
      tsBuffer->Clear();
+     resyncTsBufferM = false;
      tuner->Open();
      dvrIsOpen = true;
      }
@@ -453,17 +717,12 @@ void cSatipDevice::CloseDvr(void) {
 
 bool cSatipDevice::HasLock(int timeout) const {
   dbg_funcname_ext("%s (%d) [device %d]", __PRETTY_FUNCTION__, timeout, deviceIndex);
-  static constexpr int interval = 100;
-
-  while(timeout > 0) {
-     if (not tuner)
-        return false;
-     if (tuner->HasLock())
-        return true;
-     cCondWait::SleepMs(interval);
-     timeout -= interval;
-     }
-  return tuner && tuner->HasLock();
+  cSatipTuner* t = ActiveTuner();
+  if (not t)
+     return false;
+  if (timeout > 0)
+     return t->WaitLock(timeout); // woken up as soon as the tuner reports a lock
+  return t->HasLock();
 }
 
 bool cSatipDevice::HasInternalCam(void)
@@ -477,9 +736,14 @@ void cSatipDevice::WriteData(unsigned char* bufferP, int lengthP)
   dbg_funcname_ext("%s [device %d]", __PRETTY_FUNCTION__, deviceIndex);
   // Fill up TS buffer
   if (dvrIsOpen) {
+     // A lone packet after the reader has drained the buffer wakes it up as
+     // well, the demuxed runs rarely add up to a whole datagram
+     bool drained = tsBuffer->Available() < TS_SIZE;
      int len = tsBuffer->Put(bufferP, lengthP);
      if (len != lengthP)
         tsBuffer->ReportOverflow(lengthP - len);
+     if (drained or tsBuffer->Available() >= eDataWakeupSize)
+        dataReady.Signal();
      }
   // Filter the sections
   if (SectionFilterHandler)
@@ -521,7 +785,7 @@ int cSatipDevice::GetCISlot(void)
 cString cSatipDevice::GetTnrParameterString(void)
 {
    if (currentChannel.Ca())
-      return GetTnrUrlParameters(&currentChannel).c_str();
+      return cSatipTuneCache::GetInstance()->GetTnr(&currentChannel);
    return NULL;
 }
 
@@ -543,15 +807,20 @@ unsigned char* cSatipDevice::GetData(int *availableP, bool checkTsBuffer)
         return NULL;
      auto p = tsBuffer->Get(count);
      if (p && count >= TS_SIZE) {
-        if (*p != TS_SYNC_BYTE) {
-           for (int i = 1; i < count; i++) {
-               if (p[i] == TS_SYNC_BYTE) {
-                  count = i;
-                  break;
-                  }
-               }
-           tsBuffer->Del(count);
-           info("Skipped %d bytes to sync on TS packet", count);
+        if (*p != TS_SYNC_BYTE or resyncTsBufferM) {
+           bool confirmed;
+           int skip = ts_sync_find(p, count, &confirmed);
+           // the confirming packets may wrap around the end of the buffer
+           if (not confirmed and skip < count and tsBuffer->Available() >= skip + 3 * TS_SIZE)
+              ++skip;
+           if (skip > 0) {
+              tsBuffer->Del(skip);
+              info("Skipped %d bytes to sync on TS packet", skip);
+              }
+           resyncTsBufferM = not confirmed;
+           // Sleep until the packets confirming the sync byte are there
+           if (resyncTsBufferM and tsBuffer->Available() < 3 * TS_SIZE)
+              dataReady.Wait(eDataWaitMs);
            return NULL;
            }
         bytesDelivered = TS_SIZE;
@@ -561,6 +830,8 @@ unsigned char* cSatipDevice::GetData(int *availableP, bool checkTsBuffer)
         AddPidStatistic(ts_pid(p), payload(p));
         return p;
         }
+     // Sleep until WriteData() has put at least a datagram
+     dataReady.Wait(eDataWaitMs);
      }
   return NULL;
 }
@@ -570,7 +841,8 @@ void cSatipDevice::SkipData(int countP)
   dbg_funcname_ext("%s [device %d]", __PRETTY_FUNCTION__, deviceIndex);
   bytesDelivered = countP;
   // Update buffer statistics
-  AddBufferStatistic(countP, tsBuffer->Available());
+  if (dvrIsOpen)
+     AddBufferStatistic(countP, tsBuffer->Available());
 }
 
 bool cSatipDevice::GetTSPacket(unsigned char*& dataP)
@@ -8,7 +8,10 @@
 #ifndef __SATIP_DEVICE_H
 #define __SATIP_DEVICE_H
 
+#include <atomic>
+#include <map>
 #include <string>
+#include <vector>
 #include <vdr/device.h>
 #include "common.h"
 #include "deviceif.h"
@@ -25,24 +28,42 @@ public:
   static size_t Count(void);
   static cSatipDevice* GetSatipDevice(int CardIndex);
   static cString GetSatipStatus(void);
+  static void Housekeeping(void);
 
   // private parts
 private:
   enum {
     eReadyTimeoutMs  = 2000, // in milliseconds
-    eTuningTimeoutMs = 1000  // in milliseconds
+    eTuningTimeoutMs = 1000, // in milliseconds
+    eTuningAttempts  = 3,
+    eDataWaitMs      = 10,   // in milliseconds
+    eDataWakeupSize  = 7 * TS_SIZE
   };
   int deviceIndex;
   int bytesDelivered;
   bool dvrIsOpen;
   bool checkTsBufferM;
+  // the TS buffer starts at an unconfirmed sync byte
+  bool resyncTsBufferM;
   std::string serverString;
   cChannel currentChannel;
   cRingBufferLinear *tsBuffer;
+  // woken by WriteData(), the ring buffer itself doesn't wait for data
+  cCondWait dataReady;
   cSatipTuner* tuner;
   cSatipSectionFilterHandler* SectionFilterHandler;
+  // the buffers, sockets and threads only exist while the device is in use
+  cMutex resourcesMtx;
+  cTimeMs lastUse;
   cTimeMs ReadyTimeout;
   cCondVar tunerLocked;
+  // stream sharing: the device whose session is used and the devices using ours
+  cSatipDevice* streamHost;
+  std::vector<cSatipDevice*> streamGuests;
+  bool switching;
+  // serializes the zapping of VDR and the resuming of a handed over guest
+  cMutex zapMtx;
+  std::atomic<bool> resumePending;
 
   // constructor & destructor
 public:
@@ -52,7 +73,19 @@ public:
 
   // copy and assignment constructors
 private:
-  static cMutex SetChannelMtx;
+  static cMutex TuningLocksMtx;
+  static std::map<std::string, cMutex> TuningLocks;
+  static cMutex* GetTuningLock(const char* address);
+  static cMutex StreamBrokerMtx;
+  cSatipTuner* ActiveTuner(void) const;
+  bool JoinStream(const cChannel* channel);
+  void LeaveStream(void);
+  void HandOverGuests(bool retune);
+  void SetGuestPid(int pid, int type, bool on);
+  bool TuneChannel(const cChannel* channel, bool wait = true);
+  void ResumeStream(void);
+  bool AcquireResources(void);
+  void ReleaseResources(void);
   cSatipDevice(const cSatipDevice&);
   cSatipDevice& operator=(const cSatipDevice&);
 
@@ -6,6 +6,7 @@
  */
 
 #include <string.h>
+#include <vdr/plugin.h>
 #ifdef USE_TINYXML
  #include <tinyxml.h>
 #else
@@ -34,8 +35,10 @@ bool cSatipDiscover::Initialize(cSatipDiscoverServers *serversP)
         for (cSatipDiscoverServer *s = serversP->First(); s; s = serversP->Next(s))
             instanceS->AddServer(s->SrcAddress(), s->IpAddress(), s->IpPort(), s->Model(), s->Filters(), s->Description(), s->Quirk());
         }
-     else
+     else {
+        instanceS->LoadCache();
         instanceS->Activate();
+        }
      }
   return true;
 }
@@ -49,31 +52,31 @@ void cSatipDiscover::Destroy(void)
 
 size_t cSatipDiscover::HeaderCallback(char *ptrP, size_t sizeP, size_t nmembP, void *dataP)
 {
-  cSatipDiscover *obj = reinterpret_cast<cSatipDiscover *>(dataP);
+  cSatipDiscoverFetch *obj = reinterpret_cast<cSatipDiscoverFetch *>(dataP);
   size_t len = sizeP * nmembP;
   dbg_funcname_ext("%s len=%zu", __PRETTY_FUNCTION__, len);
 
   if (obj && (len > 0))
-     obj->headerBufferM.Add(ptrP, len);
+     obj->Header().Add(ptrP, len);
 
   return len;
 }
 
 size_t cSatipDiscover::DataCallback(char *ptrP, size_t sizeP, size_t nmembP, void *dataP)
 {
-  cSatipDiscover *obj = reinterpret_cast<cSatipDiscover *>(dataP);
+  cSatipDiscoverFetch *obj = reinterpret_cast<cSatipDiscoverFetch *>(dataP);
   size_t len = sizeP * nmembP;
   dbg_funcname_ext("%s len=%zu", __PRETTY_FUNCTION__, len);
 
   if (obj && (len > 0))
-     obj->dataBufferM.Add(ptrP, len);
+     obj->Data().Add(ptrP, len);
 
   return len;
 }
 
 int cSatipDiscover::DebugCallback(CURL *handleP, curl_infotype typeP, char *dataP, size_t sizeP, void *userPtrP)
 {
-  cSatipDiscover *obj = reinterpret_cast<cSatipDiscover *>(userPtrP);
+  cSatipDiscoverFetch *obj = reinterpret_cast<cSatipDiscoverFetch *>(userPtrP);
 
   if (obj) {
      switch (typeP) {
@@ -103,14 +106,15 @@ int cSatipDiscover::DebugCallback(CURL *handleP, curl_infotype typeP, char *data
 cSatipDiscover::cSatipDiscover()
 : cThread("SATIP discover"),
   mutexM(),
-  headerBufferM(),
-  dataBufferM(),
   msearchM(*this),
   probeUrlListM(),
-  handleM(curl_easy_init()),
+  multiM(curl_multi_init()),
+  fetchesM(),
   sleepM(),
   probeIntervalM(0),
-  serversM()
+  serversM(),
+  cacheFileM(AddDirectory(cPlugin::CacheDirectory(PLUGIN_NAME_I18N), "servers.cache")),
+  cacheStateM(-1)
 {
   dbg_funcname("%s", __PRETTY_FUNCTION__);
 }
@@ -121,9 +125,12 @@ cSatipDiscover::~cSatipDiscover()
   Deactivate();
   cMutexLock MutexLock(&mutexM);
   // Free allocated memory
-  if (handleM)
-     curl_easy_cleanup(handleM);
-  handleM = NULL;
+  for (cSatipDiscoverFetch *fetch = fetchesM.First(); fetch; fetch = fetchesM.Next(fetch))
+      curl_multi_remove_handle(multiM, fetch->Handle());
+  fetchesM.Clear();
+  if (multiM)
+     curl_multi_cleanup(multiM);
+  multiM = NULL;
   probeUrlListM.Clear();
 }
 
@@ -157,6 +164,8 @@ void cSatipDiscover::Action(void)
            mutexM.Lock();
            serversM.Cleanup(eCleanupTimeoutMs);
            mutexM.Unlock();
+           // refresh the last seen times
+           SaveCache();
            }
         mutexM.Lock();
         if (probeUrlListM.Size()) {
@@ -171,7 +180,12 @@ void cSatipDiscover::Action(void)
            tmp.Clear();
            }
         // to avoid busy loop and reduce cpu load
-        sleepM.Wait(eSleepTimeoutMs);
+        if (fetchesM.Count())
+           ProcessFetches(eSleepTimeoutMs);
+        else
+           sleepM.Wait(eSleepTimeoutMs);
+        if (cacheStateM != GetServersState())
+           SaveCache();
         }
   dbg_funcname("%s Exiting", __PRETTY_FUNCTION__);
 }
@@ -179,59 +193,164 @@ void cSatipDiscover::Action(void)
 void cSatipDiscover::Fetch(const char *urlP)
 {
   dbg_funcname("%s (%s)", __PRETTY_FUNCTION__, urlP);
-  if (handleM && !isempty(urlP)) {
-     const char *addr = NULL;
-     long rc = 0;
+  if (multiM && !isempty(urlP)) {
+     // Skip servers that are already being fetched
+     for (cSatipDiscoverFetch *fetch = fetchesM.First(); fetch; fetch = fetchesM.Next(fetch)) {
+         if (strcmp(fetch->Url(), urlP) == 0)
+            return;
+         }
+     CURL *handle = curl_easy_init();
+     if (!handle) {
+        error("Discovery cannot create a transfer for %s", urlP);
+        return;
+        }
+     cSatipDiscoverFetch *fetch = new cSatipDiscoverFetch(handle, urlP);
      CURLcode res = CURLE_OK;
 
      // Verbose output
-     SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_VERBOSE, 1L);
-     SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_DEBUGFUNCTION, cSatipDiscover::DebugCallback);
-     SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_DEBUGDATA, this);
+     SATIP_CURL_EASY_SETOPT(handle, CURLOPT_VERBOSE, 1L);
+     SATIP_CURL_EASY_SETOPT(handle, CURLOPT_DEBUGFUNCTION, cSatipDiscover::DebugCallback);
+     SATIP_CURL_EASY_SETOPT(handle, CURLOPT_DEBUGDATA, fetch);
 
      // Set header and data callbacks
-     SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_HEADERFUNCTION, cSatipDiscover::HeaderCallback);
-     SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_WRITEHEADER, this);
-     SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_WRITEFUNCTION, cSatipDiscover::DataCallback);
-     SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_WRITEDATA, this);
+     SATIP_CURL_EASY_SETOPT(handle, CURLOPT_HEADERFUNCTION, cSatipDiscover::HeaderCallback);
+     SATIP_CURL_EASY_SETOPT(handle, CURLOPT_WRITEHEADER, fetch);
+     SATIP_CURL_EASY_SETOPT(handle, CURLOPT_WRITEFUNCTION, cSatipDiscover::DataCallback);
+     SATIP_CURL_EASY_SETOPT(handle, CURLOPT_WRITEDATA, fetch);
 
      // No progress meter and no signaling
-     SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_NOPROGRESS, 1L);
-     SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_NOSIGNAL, 1L);
+     SATIP_CURL_EASY_SETOPT(handle, CURLOPT_NOPROGRESS, 1L);
+     SATIP_CURL_EASY_SETOPT(handle, CURLOPT_NOSIGNAL, 1L);
 
-     // Set timeouts
-     SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_TIMEOUT_MS, (long)eConnectTimeoutMs);
-     SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_CONNECTTIMEOUT_MS, (long)eConnectTimeoutMs);
+     // Set timeouts, each transfer keeps its own ones
+     SATIP_CURL_EASY_SETOPT(handle, CURLOPT_TIMEOUT_MS, (long)eConnectTimeoutMs);
+     SATIP_CURL_EASY_SETOPT(handle, CURLOPT_CONNECTTIMEOUT_MS, (long)eConnectTimeoutMs);
 
      // Set user-agent
-     SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_USERAGENT, *cString::sprintf("vdr-%s/%s", PLUGIN_NAME_I18N, VERSION));
+     SATIP_CURL_EASY_SETOPT(handle, CURLOPT_USERAGENT, *cString::sprintf("vdr-%s/%s", PLUGIN_NAME_I18N, VERSION));
 
      // Set URL
-     SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_URL, urlP);
-
-     // Fetch the data
-     SATIP_CURL_EASY_PERFORM(handleM);
-     SATIP_CURL_EASY_GETINFO(handleM, CURLINFO_RESPONSE_CODE, &rc);
-     SATIP_CURL_EASY_GETINFO(handleM, CURLINFO_PRIMARY_IP, &addr);
-     if (rc == 200) {
-        ParseDeviceInfo(addr, ParseRtspPort());
-        headerBufferM.Reset();
-        dataBufferM.Reset();
+     SATIP_CURL_EASY_SETOPT(handle, CURLOPT_URL, urlP);
+
+     // Queue the transfer
+     CURLMcode mres = curl_multi_add_handle(multiM, handle);
+     if (mres != CURLM_OK) {
+        error("Discovery cannot queue %s: %s", urlP, curl_multi_strerror(mres));
+        delete fetch;
+        return;
         }
-     else
-        error("Discovery detected invalid status code: %ld", rc);
+     fetchesM.Add(fetch);
+     }
+}
+
+void cSatipDiscover::ProcessFetches(int timeoutMsP)
+{
+  dbg_funcname_ext("%s (%d) fetches=%d", __PRETTY_FUNCTION__, timeoutMsP, fetchesM.Count());
+  int running = 0, numfds = 0, left = 0;
+  CURLMsg *msg;
+
+  curl_multi_perform(multiM, &running);
+  if (running) {
+     curl_multi_wait(multiM, NULL, 0, timeoutMsP, &numfds);
+     curl_multi_perform(multiM, &running);
+     }
+  // Parse each description as soon as its transfer is done
+  while ((msg = curl_multi_info_read(multiM, &left)) != NULL) {
+        if (msg->msg != CURLMSG_DONE)
+           continue;
+        cSatipDiscoverFetch *fetch = fetchesM.First();
+        while (fetch && fetch->Handle() != msg->easy_handle)
+              fetch = fetchesM.Next(fetch);
+        if (!fetch)
+           continue;
+        if (msg->data.result == CURLE_OK) {
+           const char *addr = NULL;
+           long rc = 0;
+           CURLcode res = CURLE_OK;
+           SATIP_CURL_EASY_GETINFO(fetch->Handle(), CURLINFO_RESPONSE_CODE, &rc);
+           SATIP_CURL_EASY_GETINFO(fetch->Handle(), CURLINFO_PRIMARY_IP, &addr);
+           if (rc == 200) {
+              mutexM.Lock();
+              locationsM[fetch->Url()] = addr ? addr : "";
+              mutexM.Unlock();
+              ParseDeviceInfo(addr, ParseRtspPort(fetch->Header()), fetch->Data());
+              }
+           else
+              error("Discovery detected invalid status code: %ld", rc);
+           }
+        else
+           error("Discovery of %s failed: %s", fetch->Url(), curl_easy_strerror(msg->data.result));
+        curl_multi_remove_handle(multiM, fetch->Handle());
+        fetchesM.Del(fetch);
+        }
+}
+
+void cSatipDiscover::LoadCache(void)
+{
+  dbg_funcname("%s (%s)", __PRETTY_FUNCTION__, *cacheFileM);
+  FILE *f = fopen(*cacheFileM, "r");
+  if (!f)
+     return;
+  // line format: <last seen>|<address>|<port>|<model>|<filters>|<quirks>|<source address>|<description>
+  cMutexLock MutexLock(&mutexM);
+  cReadLine ReadLine;
+  char *line;
+  time_t now = time(NULL);
+  while ((line = ReadLine.Read(f)) != NULL) {
+        char *fields[8];
+        unsigned int n = 0;
+        fields[n++] = line;
+        while (n < ELEMENTS(fields)) {
+              char *c = strchr(fields[n - 1], '|');
+              if (!c)
+                 break;
+              *c = 0;
+              fields[n++] = c + 1;
+              }
+        if (n != ELEMENTS(fields)) {
+           error("Invalid server cache entry in %s", *cacheFileM);
+           continue;
+           }
+        time_t seen = strtol(fields[0], NULL, 10);
+        if (now - seen > eCacheMaxAge)
+           continue;
+        int quirk = SatipConfig.GetDisableServerQuirks() ? cSatipServer::eSatipQuirkNone : (int)strtol(fields[5], NULL, 10);
+        cSatipServer *tmp = new cSatipServer(fields[6], fields[1], atoi(fields[2]), fields[3], fields[4], fields[7], quirk);
+        if (serversM.Find(tmp)) {
+           DELETENULL(tmp);
+           continue;
+           }
+        tmp->SetProvisional(seen);
+        info("Adding cached server '%s|%s|%s' Bind: %s Filters: %s CI: %s Quirks: %s", tmp->Address(), tmp->Model(), tmp->Description(), !isempty(tmp->SrcAddress()) ? tmp->SrcAddress() : "default", !isempty(tmp->Filters()) ? tmp->Filters() : "none", tmp->HasCI() ? "yes" : "no", tmp->HasQuirk() ? tmp->Quirks() : "none");
+        serversM.Add(tmp);
+        }
+  fclose(f);
+  cacheStateM = serversM.State();
+}
+
+void cSatipDiscover::SaveCache(void)
+{
+  dbg_funcname_ext("%s (%s)", __PRETTY_FUNCTION__, *cacheFileM);
+  cMutexLock MutexLock(&mutexM);
+  cSafeFile f(*cacheFileM);
+  if (f.Open()) {
+     for (cSatipServer *s = serversM.First(); s; s = serversM.Next(s))
+         fprintf(f, "%ld|%s|%d|%s|%s|%d|%s|%s\n", (long)s->LastSeenTime(), s->Address(), s->Port(), s->Model(), s->Filters(), s->QuirkMask(), s->SrcAddress(), s->Description());
+     if (!f.Close())
+        error("Cannot write server cache %s", *cacheFileM);
      }
+  cacheStateM = serversM.State();
 }
 
-int cSatipDiscover::ParseRtspPort(void)
+int cSatipDiscover::ParseRtspPort(cSatipMemoryBuffer &headerP)
 {
   dbg_funcname("%s", __PRETTY_FUNCTION__);
-  char *s, *p = headerBufferM.Data();
+  char *s, *p = headerP.Data();
   char *r = strtok_r(p, "\r\n", &s);
   int port = SATIP_DEFAULT_RTSP_PORT;
 
   while (r) {
-        dbg_funcname_ext("%s (%zu): %s", __PRETTY_FUNCTION__, headerBufferM.Size(), r);
+        dbg_funcname_ext("%s (%zu): %s", __PRETTY_FUNCTION__, headerP.Size(), r);
         r = skipspace(r);
         if (strstr(r, "X-SATIP-RTSP-Port")) {
            int tmp = -1;
@@ -246,13 +365,13 @@ int cSatipDiscover::ParseRtspPort(void)
   return port;
 }
 
-void cSatipDiscover::ParseDeviceInfo(const char *addrP, const int portP)
+void cSatipDiscover::ParseDeviceInfo(const char *addrP, const int portP, cSatipMemoryBuffer &dataP)
 {
   dbg_funcname("%s (%s, %d)", __PRETTY_FUNCTION__, addrP, portP);
   const char *desc = NULL, *model = NULL;
 #ifdef USE_TINYXML
   TiXmlDocument doc;
-  doc.Parse(dataBufferM.Data());
+  doc.Parse(dataP.Data());
   TiXmlHandle docHandle(&doc);
   TiXmlElement *descElement = docHandle.FirstChild("root").FirstChild("device").FirstChild("friendlyName").ToElement();
   if (descElement)
@@ -262,7 +381,7 @@ void cSatipDiscover::ParseDeviceInfo(const char *addrP, const int portP)
      model = modelElement->GetText() ? modelElement->GetText() : "DVBS2-1";
 #else
   pugi::xml_document doc;
-  if (doc.load_buffer(dataBufferM.Data(), dataBufferM.Size())) {
+  if (doc.load_buffer(dataP.Data(), dataP.Size())) {
      pugi::xml_node descNode = doc.first_element_by_path("root/device/friendlyName");
      if (descNode)
         desc = descNode.text().as_string("MyBrokenHardware");
@@ -321,6 +440,29 @@ cSatipServer *cSatipDiscover::AssignServer(int deviceIdP, int sourceP, int trans
   return serversM.Assign(deviceIdP, sourceP, transponderP, systemP);
 }
 
+cSatipServer *cSatipDiscover::AssignServer(int deviceIdP, int sourceP, int transponderP, int systemP, const std::vector<cSatipServer *> &candidatesP, int stateP)
+{
+  dbg_funcname_ext("%s (%d, %d, %d, %d, %zu, %d)", __PRETTY_FUNCTION__, deviceIdP, sourceP, transponderP, systemP, candidatesP.size(), stateP);
+  cMutexLock MutexLock(&mutexM);
+  // Stale candidates might point to already removed servers
+  if (stateP != serversM.State())
+     return serversM.Assign(deviceIdP, sourceP, transponderP, systemP);
+  return serversM.Assign(deviceIdP, sourceP, transponderP, systemP, candidatesP);
+}
+
+int cSatipDiscover::GetCandidateServers(int sourceP, std::vector<cSatipServer *> &serversP)
+{
+  dbg_funcname_ext("%s (%d)", __PRETTY_FUNCTION__, sourceP);
+  cMutexLock MutexLock(&mutexM);
+  return serversM.Candidates(sourceP, serversP);
+}
+
+int cSatipDiscover::GetServersState(void)
+{
+  cMutexLock MutexLock(&mutexM);
+  return serversM.State();
+}
+
 cSatipServer *cSatipDiscover::GetServer(int sourceP)
 {
   dbg_funcname_ext("%s (%d)", __PRETTY_FUNCTION__, sourceP);
@@ -391,6 +533,13 @@ bool cSatipDiscover::HasServerCI(cSatipServer *serverP)
   return serversM.HasCI(serverP);
 }
 
+void cSatipDiscover::CountServerDescribe(cSatipServer *serverP, bool avoidedP)
+{
+  dbg_funcname_ext("%s (, %d)", __PRETTY_FUNCTION__, avoidedP);
+  cMutexLock MutexLock(&mutexM);
+  serversM.CountDescribe(serverP, avoidedP);
+}
+
 cString cSatipDiscover::GetSourceAddress(cSatipServer *serverP)
 {
   dbg_funcname_ext("%s", __PRETTY_FUNCTION__);
@@ -398,6 +547,13 @@ cString cSatipDiscover::GetSourceAddress(cSatipServer *serverP)
   return serversM.GetSrcAddress(serverP);
 }
 
+void cSatipDiscover::AddServerTraffic(cSatipServer *serverP, long bytesP)
+{
+  dbg_funcname_ext("%s (, %ld)", __PRETTY_FUNCTION__, bytesP);
+  cMutexLock MutexLock(&mutexM);
+  serversM.AddTraffic(serverP, bytesP);
+}
+
 cString cSatipDiscover::GetServerAddress(cSatipServer *serverP)
 {
   dbg_funcname_ext("%s", __PRETTY_FUNCTION__);
@@ -427,3 +583,25 @@ void cSatipDiscover::SetUrl(const char *urlP)
   mutexM.Unlock();
   sleepM.Signal();
 }
+
+void cSatipDiscover::RefreshUrl(const char *urlP)
+{
+  dbg_funcname_ext("%s (%s)", __PRETTY_FUNCTION__, urlP);
+  mutexM.Lock();
+  std::map<std::string, std::string>::const_iterator it = locationsM.find(urlP);
+  // Fetch the description again only if the servers have vanished meanwhile
+  bool known = (it != locationsM.end()) && serversM.Refresh(it->second.c_str());
+  mutexM.Unlock();
+  if (!known)
+     SetUrl(urlP);
+}
+
+void cSatipDiscover::RemoveUrl(const char *urlP)
+{
+  dbg_funcname("%s (%s)", __PRETTY_FUNCTION__, urlP);
+  cMutexLock MutexLock(&mutexM);
+  std::map<std::string, std::string>::const_iterator it = locationsM.find(urlP);
+  // The location is kept for reactivating the servers on their next NOTIFY
+  if (it != locationsM.end())
+     serversM.Depart(it->second.c_str());
+}
@@ -8,6 +8,9 @@
 #ifndef __SATIP_DISCOVER_H
 #define __SATIP_DISCOVER_H
 
+#include <map>
+#include <string>
+
 #include <curl/curl.h>
 
 #include <vdr/thread.h>
@@ -45,6 +48,24 @@ public:
 class cSatipDiscoverServers : public cList<cSatipDiscoverServer> {
 };
 
+class cSatipDiscoverFetch : public cListObject {
+private:
+  CURL *handleM;
+  cString urlM;
+  cSatipMemoryBuffer headerM;
+  cSatipMemoryBuffer dataM;
+  // to prevent copy constructor and assignment
+  cSatipDiscoverFetch(const cSatipDiscoverFetch&);
+  cSatipDiscoverFetch& operator=(const cSatipDiscoverFetch&);
+public:
+  cSatipDiscoverFetch(CURL *handleP, const char *urlP) : handleM(handleP), urlM(urlP) {}
+  virtual ~cSatipDiscoverFetch() { if (handleM) curl_easy_cleanup(handleM); }
+  CURL *Handle(void)            { return handleM; }
+  const char *Url(void)         { return *urlM; }
+  cSatipMemoryBuffer &Header(void) { return headerM; }
+  cSatipMemoryBuffer &Data(void)   { return dataM; }
+};
+
 class cSatipDiscover : public cThread, public cSatipDiscoverIf {
 private:
   enum {
@@ -52,27 +73,33 @@ private:
     eConnectTimeoutMs = 1500,  // in milliseconds
     eProbeTimeoutMs   = 2000,  // in milliseconds
     eProbeIntervalMs  = 60000, // in milliseconds
-    eCleanupTimeoutMs = 124000 // in milliseoonds
+    eCleanupTimeoutMs = 124000, // in milliseoonds
+    eCacheMaxAge      = 604800  // in seconds
   };
   static cSatipDiscover *instanceS;
   static size_t HeaderCallback(char *ptrP, size_t sizeP, size_t nmembP, void *dataP);
   static size_t DataCallback(char *ptrP, size_t sizeP, size_t nmembP, void *dataP);
   static int    DebugCallback(CURL *handleP, curl_infotype typeP, char *dataP, size_t sizeP, void *userPtrP);
   cMutex mutexM;
-  cSatipMemoryBuffer headerBufferM;
-  cSatipMemoryBuffer dataBufferM;
   cSatipMsearch msearchM;
   cStringList probeUrlListM;
-  CURL *handleM;
+  CURLM *multiM;
+  cList<cSatipDiscoverFetch> fetchesM;
   cCondWait sleepM;
   cTimeMs probeIntervalM;
   cSatipServers serversM;
+  std::map<std::string, std::string> locationsM;
+  cString cacheFileM;
+  int cacheStateM;
   void Activate(void);
   void Deactivate(void);
-  int ParseRtspPort(void);
-  void ParseDeviceInfo(const char *addrP, const int portP);
+  int ParseRtspPort(cSatipMemoryBuffer &headerP);
+  void ParseDeviceInfo(const char *addrP, const int portP, cSatipMemoryBuffer &dataP);
   void AddServer(const char *srcAddrP, const char *addrP, const int portP, const char *modelP, const char *filtersP, const char *descP, const int quirkP);
   void Fetch(const char *urlP);
+  void ProcessFetches(int timeoutMsP);
+  void LoadCache(void);
+  void SaveCache(void);
   // constructor
   cSatipDiscover();
   // to prevent copy constructor and assignment
@@ -90,6 +117,9 @@ public:
   void TriggerScan(void) { probeIntervalM.Set(0); }
   int GetServerCount(void);
   cSatipServer *AssignServer(int deviceIdP, int sourceP, int transponderP, int systemP);
+  cSatipServer *AssignServer(int deviceIdP, int sourceP, int transponderP, int systemP, const std::vector<cSatipServer *> &candidatesP, int stateP);
+  int GetCandidateServers(int sourceP, std::vector<cSatipServer *> &serversP);
+  int GetServersState(void);
   cSatipServer *GetServer(int sourceP);
   cSatipServer *GetServer(cSatipServer *serverP);
   cSatipServers *GetServers(void);
@@ -99,6 +129,8 @@ public:
   void DetachServer(cSatipServer *serverP, int deviceIdP, int transponderP);
   bool IsServerQuirk(cSatipServer *serverP, int quirkP);
   bool HasServerCI(cSatipServer *serverP);
+  void CountServerDescribe(cSatipServer *serverP, bool avoidedP);
+  void AddServerTraffic(cSatipServer *serverP, long bytesP);
   cString GetServerAddress(cSatipServer *serverP);
   cString GetSourceAddress(cSatipServer *serverP);
   int GetServerPort(cSatipServer *serverP);
@@ -108,6 +140,8 @@ public:
   // for internal discover interface
 public:
   virtual void SetUrl(const char *urlP);
+  virtual void RefreshUrl(const char *urlP);
+  virtual void RemoveUrl(const char *urlP);
 };
 
 #endif // __SATIP_DISCOVER_H
@@ -13,6 +13,8 @@ public:
   cSatipDiscoverIf() {}
   virtual ~cSatipDiscoverIf() {}
   virtual void SetUrl(const char *urlP) = 0;
+  virtual void RefreshUrl(const char *urlP) = 0;
+  virtual void RemoveUrl(const char *urlP) = 0;
 
 private:
   explicit cSatipDiscoverIf(const cSatipDiscoverIf&);
@@ -0,0 +1,164 @@
+/*
+ * eventloop.c: SAT>IP plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <algorithm>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "common.h"
+#include "log.h"
+#include "eventloop.h"
+
+cSatipEventLoop *cSatipEventLoop::loopsS[eMaxEventLoops] = { NULL };
+int cSatipEventLoop::countS = 0;
+
+bool cSatipEventLoop::Initialize(int countP)
+{
+  dbg_funcname("%s (%d)", __PRETTY_FUNCTION__, countP);
+  countP = std::min(countP, (int)eMaxEventLoops);
+  for (int i = countS; i < countP; ++i) {
+      loopsS[i] = new cSatipEventLoop(i);
+      loopsS[i]->Start();
+      countS = i + 1;
+      }
+  return true;
+}
+
+void cSatipEventLoop::Destroy(void)
+{
+  dbg_funcname("%s", __PRETTY_FUNCTION__);
+  // The devices detach themselves later on, so only the threads are stopped
+  for (int i = 0; i < countS; ++i) {
+      if (loopsS[i]->Running()) {
+         loopsS[i]->Cancel(-1);
+         loopsS[i]->Wakeup();
+         loopsS[i]->Cancel(3);
+         }
+      }
+}
+
+cSatipEventLoop *cSatipEventLoop::Get(int deviceIndexP)
+{
+  // Devices are pinned to a loop for their lifetime
+  return countS ? loopsS[deviceIndexP % countS] : NULL;
+}
+
+cSatipEventLoop::cSatipEventLoop(int indexP)
+: cThread(cString::sprintf("SATIP event loop %d", indexP)),
+  mutexM(),
+  wakeupMutexM(),
+  epollFdM(epoll_create1(EPOLL_CLOEXEC)),
+  eventFdM(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+  timerFdM(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)),
+  clientsM(),
+  wokenM()
+{
+  dbg_funcname("%s (%d)", __PRETTY_FUNCTION__, indexP);
+  int fds[] = { eventFdM, timerFdM };
+  for (unsigned int i = 0; i < ELEMENTS(fds); ++i) {
+      struct epoll_event ev;
+      ev.events = EPOLLIN;
+      ev.data.fd = fds[i];
+      ERROR_IF(epoll_ctl(epollFdM, EPOLL_CTL_ADD, fds[i], &ev) == -1, "epoll_ctl(EPOLL_CTL_ADD) failed");
+      }
+}
+
+cSatipEventLoop::~cSatipEventLoop()
+{
+  dbg_funcname("%s", __PRETTY_FUNCTION__);
+  if (Running())
+     Cancel(3);
+  close(timerFdM);
+  close(eventFdM);
+  close(epollFdM);
+}
+
+void cSatipEventLoop::Arm(int timeoutMsP)
+{
+  // A one-shot timer for the earliest client, zero would disarm it
+  struct itimerspec its;
+  memset(&its, 0, sizeof(its));
+  timeoutMsP = std::max(timeoutMsP, 1);
+  its.it_value.tv_sec = timeoutMsP / 1000;
+  its.it_value.tv_nsec = (timeoutMsP % 1000) * 1000000L;
+  ERROR_IF(timerfd_settime(timerFdM, 0, &its, NULL) == -1, "timerfd_settime() failed");
+}
+
+void cSatipEventLoop::Action(void)
+{
+  dbg_funcname("%s Entering", __PRETTY_FUNCTION__);
+  struct epoll_event events[2];
+  std::vector<cSatipEventLoopIf *> woken;
+  // Do the thread loop
+  while (Running()) {
+        int nfds = epoll_wait(epollFdM, events, ELEMENTS(events), -1);
+        ERROR_IF_FUNC((nfds == -1 && errno != EINTR), "epoll_wait() failed", break, ;);
+        for (int i = 0; i < nfds; ++i) {
+            uint64_t count;
+            // Only the wakeup matters, not how many of them were pending
+            if (read(events[i].data.fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+               error("Reading event loop descriptor failed");
+            }
+        wakeupMutexM.Lock();
+        woken.swap(wokenM);
+        wakeupMutexM.Unlock();
+        // Run only the clients woken up or due, not all on every event
+        uint64_t now = cTimeMs::Now();
+        uint64_t next = now + eMaxTimeoutMs;
+        mutexM.Lock();
+        for (std::vector<clientStruct>::iterator it = clientsM.begin(); it != clientsM.end(); ++it) {
+            if ((it->deadline <= now) || (std::find(woken.begin(), woken.end(), it->client) != woken.end()))
+               it->deadline = cTimeMs::Now() + it->client->RunOnce();
+            next = std::min(next, it->deadline);
+            }
+        mutexM.Unlock();
+        woken.clear();
+        now = cTimeMs::Now();
+        if (next > now)
+           Arm((int)(next - now));
+        else
+           Wakeup();
+        }
+  dbg_funcname("%s Exiting", __PRETTY_FUNCTION__);
+}
+
+void cSatipEventLoop::Attach(cSatipEventLoopIf *clientP)
+{
+  dbg_funcname("%s (%s)", __PRETTY_FUNCTION__, *clientP->ToString());
+  cMutexLock MutexLock(&mutexM);
+  clientStruct client = { clientP, 0 };
+  clientsM.push_back(client);
+  Wakeup();
+}
+
+void cSatipEventLoop::Detach(cSatipEventLoopIf *clientP)
+{
+  dbg_funcname("%s (%s)", __PRETTY_FUNCTION__, *clientP->ToString());
+  // Waits for a running iteration, so the client can be deleted afterwards
+  cMutexLock MutexLock(&mutexM);
+  for (std::vector<clientStruct>::iterator it = clientsM.begin(); it != clientsM.end(); ++it) {
+      if (it->client == clientP) {
+         clientsM.erase(it);
+         break;
+         }
+      }
+  cMutexLock WakeupLock(&wakeupMutexM);
+  wokenM.erase(std::remove(wokenM.begin(), wokenM.end(), clientP), wokenM.end());
+}
+
+void cSatipEventLoop::Wakeup(cSatipEventLoopIf *clientP)
+{
+  if (clientP) {
+     cMutexLock MutexLock(&wakeupMutexM);
+     if (std::find(wokenM.begin(), wokenM.end(), clientP) == wokenM.end())
+        wokenM.push_back(clientP);
+     }
+  uint64_t one = 1;
+  if (write(eventFdM, &one, sizeof(one)) < 0 && errno != EAGAIN)
+     error("Waking up event loop failed");
+}
@@ -0,0 +1,60 @@
+/*
+ * eventloop.h: SAT>IP plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __SATIP_EVENTLOOP_H
+#define __SATIP_EVENTLOOP_H
+
+#include <vector>
+#include <vdr/thread.h>
+#include <vdr/tools.h>
+
+#include "eventloopif.h"
+
+// Drives the tuners and section handlers of several devices from a single
+// thread instead of one thread each.
+class cSatipEventLoop : public cThread {
+private:
+  enum {
+    eMaxEventLoops = 8,
+    eMaxTimeoutMs  = 1000 // in milliseconds
+  };
+  static cSatipEventLoop *loopsS[eMaxEventLoops];
+  static int countS;
+  // a client and the time of its next run
+  struct clientStruct {
+    cSatipEventLoopIf *client;
+    uint64_t deadline;
+  };
+  cMutex mutexM;
+  cMutex wakeupMutexM;
+  int epollFdM;
+  int eventFdM;
+  int timerFdM;
+  std::vector<clientStruct> clientsM;
+  // the clients woken up since the last round
+  std::vector<cSatipEventLoopIf *> wokenM;
+  void Arm(int timeoutMsP);
+  // constructor
+  explicit cSatipEventLoop(int indexP);
+  // to prevent copy constructor and assignment
+  cSatipEventLoop(const cSatipEventLoop&);
+  cSatipEventLoop& operator=(const cSatipEventLoop&);
+
+protected:
+  virtual void Action(void);
+
+public:
+  static bool Initialize(int countP);
+  static void Destroy(void);
+  static cSatipEventLoop *Get(int deviceIndexP);
+  virtual ~cSatipEventLoop();
+  void Attach(cSatipEventLoopIf *clientP);
+  void Detach(cSatipEventLoopIf *clientP);
+  void Wakeup(cSatipEventLoopIf *clientP = NULL);
+};
+
+#endif // __SATIP_EVENTLOOP_H
@@ -0,0 +1,24 @@
+/*
+ * eventloopif.h: SAT>IP plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __SATIP_EVENTLOOPIF_H
+#define __SATIP_EVENTLOOPIF_H
+
+class cSatipEventLoopIf {
+public:
+  cSatipEventLoopIf() {}
+  virtual ~cSatipEventLoopIf() {}
+  // returns the time until the next run in milliseconds, zero for at once
+  virtual int RunOnce(void) = 0;
+  virtual cString ToString(void) const = 0;
+
+private:
+  explicit cSatipEventLoopIf(const cSatipEventLoopIf&);
+  cSatipEventLoopIf& operator=(const cSatipEventLoopIf&);
+};
+
+#endif // __SATIP_EVENTLOOPIF_H
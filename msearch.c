@@ -18,6 +18,7 @@ const char *cSatipMsearch::bcastMessageS = "M-SEARCH * HTTP/1.1\r\n"
                                            "MAN: \"ssdp:discover\"\r\n"               \
                                            "ST: urn:ses-com:device:SatIPServer:1\r\n" \
                                            "MX: 2\r\n\r\n";
+const char *cSatipMsearch::serverTypeS   = "urn:ses-com:device:SatIPServer:1";
 
 cSatipMsearch::cSatipMsearch(cSatipDiscoverIf &discoverP)
 : discoverM(discoverP),
@@ -29,7 +30,8 @@ cSatipMsearch::cSatipMsearch(cSatipDiscoverIf &discoverP)
      memset(bufferM, 0, bufferLenM);
   else
      error("Cannot create Msearch buffer!");
-  if (!Open(eDiscoveryPort, true))
+  // Join the SSDP group to receive also the NOTIFY announcements
+  if (!OpenMulticast(eDiscoveryPort, bcastAddressS, NULL, true))
      error("Cannot open Msearch port!");
 }
 
@@ -56,6 +58,30 @@ int cSatipMsearch::GetFd(void)
   return Fd();
 }
 
+void cSatipMsearch::Announce(const char *usnP, const char *locationP, const char *bootIdP)
+{
+  dbg_funcname_ext("%s (%s, %s, %s)", __PRETTY_FUNCTION__, usnP, locationP, bootIdP);
+  std::pair<std::string, std::string> &device = devicesM[usnP];
+  // Skip the description fetch, if the server hasn't changed since
+  if (device.first == locationP && device.second == bootIdP)
+     discoverM.RefreshUrl(locationP);
+  else {
+     device.first = locationP;
+     device.second = bootIdP;
+     discoverM.SetUrl(locationP);
+     }
+}
+
+void cSatipMsearch::Revoke(const char *usnP)
+{
+  dbg_funcname_ext("%s (%s)", __PRETTY_FUNCTION__, usnP);
+  std::map<std::string, std::pair<std::string, std::string> >::iterator it = devicesM.find(usnP);
+  if (it != devicesM.end()) {
+     discoverM.RemoveUrl(it->second.first.c_str());
+     devicesM.erase(it);
+     }
+}
+
 void cSatipMsearch::Process(void)
 {
   dbg_funcname_ext("%s", __PRETTY_FUNCTION__);
@@ -64,38 +90,61 @@ void cSatipMsearch::Process(void)
      while ((length = Read(bufferM, bufferLenM)) > 0) {
            bufferM[min(length, int(bufferLenM - 1))] = 0;
            dbg_msearch("%s len=%d buf=%s", __PRETTY_FUNCTION__, length, bufferM);
-           bool status = false, valid = false;
-           char *s, *p = reinterpret_cast<char *>(bufferM), *location = NULL;
+           bool status = false, notify = false, valid = false, alive = true;
+           char *s, *p = reinterpret_cast<char *>(bufferM), *location = NULL, *usn = NULL, *bootid = NULL;
            char *r = strtok_r(p, "\r\n", &s);
            while (r) {
                  dbg_msearch("%s r=%s", __PRETTY_FUNCTION__, r);
-                 // Check the status code
+                 // Check the status code or the announcement
                  // HTTP/1.1 200 OK
-                 if (!status && startswith(r, "HTTP/1.1 200 OK"))
-                    status = true;
-                 if (status) {
-                    // Check the location data
-                    // LOCATION: http://192.168.0.115:8888/octonet.xml
-                    if (strcasestr(r, "LOCATION:") == r) {
-                       location = compactspace(r + 9);
-                       dbg_funcname("%s location='%s'", __PRETTY_FUNCTION__, location);
-                       }
-                    // Check the source type
-                    // ST: urn:ses-com:device:SatIPServer:1
-                    else if (strcasestr(r, "ST:") == r) {
-                       char *st = compactspace(r + 3);
-                       if (strstr(st, "urn:ses-com:device:SatIPServer:1"))
-                          valid = true;
-                       dbg_funcname("%s st='%s'", __PRETTY_FUNCTION__, st);
-                       }
-                    // Check whether all the required data is found
-                    if (valid && !isempty(location)) {
-                       discoverM.SetUrl(location);
+                 // NOTIFY * HTTP/1.1
+                 if (!status && !notify) {
+                    if (startswith(r, "HTTP/1.1 200 OK"))
+                       status = true;
+                    else if (startswith(r, "NOTIFY * HTTP/1.1"))
+                       notify = true;
+                    else
                        break;
-                       }
                     }
+                 // Check the location data
+                 // LOCATION: http://192.168.0.115:8888/octonet.xml
+                 else if (strcasestr(r, "LOCATION:") == r) {
+                    location = compactspace(r + 9);
+                    dbg_funcname("%s location='%s'", __PRETTY_FUNCTION__, location);
+                    }
+                 // Check the source type of a reply or an announcement
+                 // ST: urn:ses-com:device:SatIPServer:1
+                 // NT: urn:ses-com:device:SatIPServer:1
+                 else if ((status && strcasestr(r, "ST:") == r) || (notify && strcasestr(r, "NT:") == r)) {
+                    char *st = compactspace(r + 3);
+                    if (strstr(st, serverTypeS))
+                       valid = true;
+                    dbg_funcname("%s st='%s'", __PRETTY_FUNCTION__, st);
+                    }
+                 // Check the announcement type
+                 // NTS: ssdp:alive
+                 // NTS: ssdp:byebye
+                 else if (notify && strcasestr(r, "NTS:") == r)
+                    alive = !strstr(r + 4, "ssdp:byebye");
+                 // Check the unique service name and boot id
+                 // USN: uuid:50c958a8-e839-4b96-b7ae-dd3b2ab90a1e::urn:ses-com:device:SatIPServer:1
+                 // BOOTID.UPNP.ORG: 2318
+                 else if (strcasestr(r, "USN:") == r)
+                    usn = compactspace(r + 4);
+                 else if (strcasestr(r, "BOOTID.UPNP.ORG:") == r)
+                    bootid = compactspace(r + 16);
                  r = strtok_r(NULL, "\r\n", &s);
                  }
+           if (valid) {
+              // Servers without an USN are identified by their location
+              const char *id = !isempty(usn) ? usn : location;
+              if (notify && !alive) {
+                 if (!isempty(id))
+                    Revoke(id);
+                 }
+              else if (!isempty(location))
+                 Announce(id, location, bootid ? bootid : "");
+              }
            }
      }
 }
@@ -8,6 +8,9 @@
 #ifndef __SATIP_MSEARCH_H_
 #define __SATIP_MSEARCH_H_
 
+#include <map>
+#include <string>
+
 #include "discoverif.h"
 #include "socket.h"
 #include "pollerif.h"
@@ -20,10 +23,15 @@ private:
   };
   static const char *bcastAddressS;
   static const char *bcastMessageS;
+  static const char *serverTypeS;
   cSatipDiscoverIf &discoverM;
+  // announced location and boot id per unique service name
+  std::map<std::string, std::pair<std::string, std::string> > devicesM;
   unsigned int bufferLenM;
   unsigned char *bufferM;
   bool registeredM;
+  void Announce(const char *usnP, const char *locationP, const char *bootIdP);
+  void Revoke(const char *usnP);
 
 public:
   explicit cSatipMsearch(cSatipDiscoverIf &discoverP);
@@ -5,8 +5,11 @@
  *
  */
 
+#include <array>
 #include <sstream>   // std::stringstream
 #include <ctype.h>
+#include <stdarg.h>
+#include <stdint.h>
 #include <vdr/dvbdevice.h>
 #include "common.h"
 #include "param.h"
@@ -19,7 +22,7 @@ struct tSatipParameterMap {
   int vdrValue;
 };
 
-static const tSatipParameterMap SatipBandwidthValues[] = {
+static constexpr tSatipParameterMap SatipBandwidthValues[] = {
   { 5000000 , "&bw=5"    , 5    },
   { 6000000 , "&bw=6"    , 6    },
   { 7000000 , "&bw=7"    , 7    },
@@ -28,18 +31,18 @@ static const tSatipParameterMap SatipBandwidthValues[] = {
   { 1712000 , "&bw=1.712", 1712 },
   { -1, nullptr, -1 }};
 
-static const tSatipParameterMap SatipPilotValues[] = {
+static constexpr tSatipParameterMap SatipPilotValues[] = {
   { PILOT_OFF , "&plts=off", 0   },
   { PILOT_ON  , "&plts=on" , 1   },
   { PILOT_AUTO, ""         , 999 },
   { -1, nullptr, -1 }};
 
-static const tSatipParameterMap SatipSisoMisoValues[] = {
+static constexpr tSatipParameterMap SatipSisoMisoValues[] = {
   { 0 , "&sm=0", 0 },
   { 1 , "&sm=1", 1 },
   { -1, nullptr, -1 }};
 
-static const tSatipParameterMap SatipCodeRateValues[] = {
+static constexpr tSatipParameterMap SatipCodeRateValues[] = {
   { FEC_NONE, ""        , 0   },
   { FEC_1_2 , "&fec=12" , 12  },
   { FEC_2_3 , "&fec=23" , 23  },
@@ -54,7 +57,7 @@ static const tSatipParameterMap SatipCodeRateValues[] = {
   { FEC_AUTO, ""        , 999 },
   { -1, nullptr, -1 }};
 
-static const tSatipParameterMap SatipModulationValues[] = {
+static constexpr tSatipParameterMap SatipModulationValues[] = {
   { QPSK    , "&mtype=qpsk"  , 2   },
   { PSK_8   , "&mtype=8psk"  , 5   },
   { APSK_16 , "&mtype=16apsk", 6   },
@@ -68,26 +71,26 @@ static const tSatipParameterMap SatipModulationValues[] = {
   { QAM_AUTO, ""             , 999 },
   { -1, nullptr, -1 }};
 
-static const tSatipParameterMap SatipSystemValuesSat[] = {
+static constexpr tSatipParameterMap SatipSystemValuesSat[] = {
   { 0, "&msys=dvbs" , 0 },
   { 1, "&msys=dvbs2", 1 },
   { -1, nullptr, -1 }};
 
-static const tSatipParameterMap SatipSystemValuesTerrestrial[] = {
+static constexpr tSatipParameterMap SatipSystemValuesTerrestrial[] = {
   { 0, "&msys=dvbt" , 0 },
   { 1, "&msys=dvbt2", 1 },
   { -1, nullptr, -1 }};
 
-static const tSatipParameterMap SatipSystemValuesCable[] = {
+static constexpr tSatipParameterMap SatipSystemValuesCable[] = {
   { 0, "&msys=dvbc" , 0 },
   { 1, "&msys=dvbc2", 1 },
   { -1, nullptr, -1 }};
 
-static const tSatipParameterMap SatipSystemValuesAtsc[] = {
+static constexpr tSatipParameterMap SatipSystemValuesAtsc[] = {
   { 0, "&msys=atsc", 0 },
   { -1, nullptr, -1 }};
 
-static const tSatipParameterMap SatipTransmissionValues[] = {
+static constexpr tSatipParameterMap SatipTransmissionValues[] = {
   { TRANSMISSION_MODE_1K  , "&tmode=1k" , 1   },
   { TRANSMISSION_MODE_2K  , "&tmode=2k" , 2   },
   { TRANSMISSION_MODE_4K  , "&tmode=4k" , 4   },
@@ -97,7 +100,7 @@ static const tSatipParameterMap SatipTransmissionValues[] = {
   { TRANSMISSION_MODE_AUTO, ""          , 999 },
   { -1, nullptr, -1 }};
 
-static const tSatipParameterMap SatipGuardValues[] = {
+static constexpr tSatipParameterMap SatipGuardValues[] = {
   { GUARD_INTERVAL_1_4   , "&gi=14"   , 4     },
   { GUARD_INTERVAL_1_8   , "&gi=18"   , 8     },
   { GUARD_INTERVAL_1_16  , "&gi=116"  , 16    },
@@ -108,85 +111,184 @@ static const tSatipParameterMap SatipGuardValues[] = {
   { GUARD_INTERVAL_AUTO  , ""         , 999   },
   { -1, nullptr, -1 }};
 
-static const tSatipParameterMap SatipRollOffValues[] = {
+static constexpr tSatipParameterMap SatipRollOffValues[] = {
   { ROLLOFF_AUTO, ""        , 0   },
   { ROLLOFF_20  , "&ro=0.20", 20  },
   { ROLLOFF_25  , "&ro=0.25", 25  },
   { ROLLOFF_35  , "&ro=0.35", 35  },
   { -1, nullptr, -1 }};
 
-static const tSatipParameterMap SatipInversionValues[] = {
+static constexpr tSatipParameterMap SatipInversionValues[] = {
   { INVERSION_AUTO, ""          , 999 },
   { INVERSION_OFF , "&specinv=0", 0   },
   { INVERSION_ON  , "&specinv=1", 1   },
   { -1, nullptr, -1 }};
 
-int SatipToVdrParameter(std::string param) {
-  const tSatipParameterMap* map = nullptr;
-
-  if (param.find("&bw=") == 0)
-     map = SatipBandwidthValues;
-  else if (param.find("&plts=") == 0)
-     map = SatipPilotValues;
-  else if (param.find("&sm=") == 0)
-     map = SatipSisoMisoValues;
-  else if (param.find("&fec=") == 0)
-     map = SatipCodeRateValues;
-  else if (param.find("&mtype=") == 0)
-     map = SatipModulationValues;
-  else if (param.find("&msys=dvbs") == 0)
-     map = SatipSystemValuesSat;
-  else if (param.find("&msys=dvbt") == 0)
-     map = SatipSystemValuesTerrestrial;
-  else if (param.find("&msys=dvbc") == 0)
-     map = SatipSystemValuesCable;
-  else if (param.find("&msys=atsc") == 0)
-     map = SatipSystemValuesAtsc;
-  else if (param.find("&tmode=") == 0)
-     map = SatipTransmissionValues;
-  else if (param.find("&gi=") == 0)
-     map = SatipGuardValues;
-  else if (param.find("&ro=") == 0)
-     map = SatipRollOffValues;
-  else if (param.find("&specinv=") == 0)
-     map = SatipInversionValues;
-
-  auto it = map;
-  while(it && it->satipString) {
-     if (it->satipString == param)
-        return it->vdrValue;
-     it++;
+// --- cSatipParameterLookup --------------------------------------------------
+
+/*
+ * Both directions are resolved by tables generated at compile time:
+ * - driver value -> URL fragment: a direct index per map, as all driver
+ *   values except the bandwidths (in Hz) are small enums.
+ * - URL token "<key>=<value>" -> VDR value: a perfect hash over every
+ *   token of all maps; the seed is searched by the compiler.
+ */
+
+static constexpr const tSatipParameterMap* SatipParameterMaps[] = {
+  SatipBandwidthValues, SatipPilotValues, SatipSisoMisoValues,
+  SatipCodeRateValues, SatipModulationValues, SatipSystemValuesSat,
+  SatipSystemValuesTerrestrial, SatipSystemValuesCable, SatipSystemValuesAtsc,
+  SatipTransmissionValues, SatipGuardValues, SatipRollOffValues,
+  SatipInversionValues };
+
+struct tSatipToken {
+  std::string_view key;
+  std::string_view value;
+  int vdrValue;
+};
+
+static constexpr size_t CountSatipTokens() {
+  size_t n = 0;
+  for(auto map : SatipParameterMaps)
+     for(auto it = map; it->satipString; it++)
+        if (*it->satipString)
+           n++;
+  return n;
+}
+
+static constexpr size_t SatipTokenCount = CountSatipTokens();
+
+static constexpr std::array<tSatipToken, SatipTokenCount> BuildSatipTokens() {
+  std::array<tSatipToken, SatipTokenCount> tokens{};
+  size_t n = 0;
+  for(auto map : SatipParameterMaps)
+     for(auto it = map; it->satipString; it++) {
+        std::string_view s(it->satipString);
+        if (s.empty())
+           continue;
+        size_t eq = s.find('=');
+        tokens[n++] = { s.substr(1, eq - 1), s.substr(eq + 1), it->vdrValue };
+        }
+  return tokens;
+}
+
+static constexpr std::array<tSatipToken, SatipTokenCount> SatipTokens = BuildSatipTokens();
+
+// FNV-1a over "<key>=<value>", without ever joining both parts.
+static constexpr uint32_t SatipTokenHash(uint32_t seed, std::string_view key, std::string_view value) {
+  uint32_t h = 2166136261u ^ (seed * 0x9E3779B9u);
+  for(char c : key)
+     h = (h ^ (uint8_t) c) * 16777619u;
+  h = (h ^ (uint8_t) '=') * 16777619u;
+  for(char c : value)
+     h = (h ^ (uint8_t) c) * 16777619u;
+  return h ^ (h >> 16);
+}
+
+static constexpr size_t SatipTokenSlots = 512; // power of two, well above SatipTokenCount
+static constexpr uint8_t SatipTokenUnused = 0xFF;
+static_assert(SatipTokenCount < SatipTokenUnused, "too many SAT>IP parameter tokens");
+
+static constexpr bool IsPerfectSatipSeed(uint32_t seed) {
+  std::array<bool, SatipTokenSlots> used{};
+  for(const auto& t : SatipTokens) {
+     size_t slot = SatipTokenHash(seed, t.key, t.value) & (SatipTokenSlots - 1);
+     if (used[slot])
+        return false;
+     used[slot] = true;
      }
-  return 999;
+  return true;
 }
 
-std::string GetTransponderUrlParameters(const cChannel* channel) {
-  std::string result;
+static constexpr uint32_t FindSatipSeed() {
+  for(uint32_t seed = 0; seed < 10000; seed++)
+     if (IsPerfectSatipSeed(seed))
+        return seed;
+  return UINT32_MAX;
+}
 
-  if (channel) {
-     auto PrintUrlString = [](int value, const tSatipParameterMap* map) -> const char* {
-        auto it = map;
-        while(it && it->satipString) {
-           if (it->driverValue == value)
-              return it->satipString;
-           it++;
-           }
-        return "";
-        };
+static constexpr uint32_t SatipTokenSeed = FindSatipSeed();
+static_assert(SatipTokenSeed != UINT32_MAX, "no perfect hash seed for SAT>IP parameter tokens");
 
-     auto PrintFloat = [](float& f) -> std::string {
-        char buf[32];
-        snprintf(buf, sizeof(buf), "%.3f", f);
-        return buf;
-        };
+static constexpr std::array<uint8_t, SatipTokenSlots> BuildSatipTokenSlots() {
+  std::array<uint8_t, SatipTokenSlots> slots{};
+  for(auto& slot : slots)
+     slot = SatipTokenUnused;
+  for(size_t i = 0; i < SatipTokenCount; i++)
+     slots[SatipTokenHash(SatipTokenSeed, SatipTokens[i].key, SatipTokens[i].value) & (SatipTokenSlots - 1)] = i;
+  return slots;
+}
+
+static constexpr std::array<uint8_t, SatipTokenSlots> SatipTokenIndex = BuildSatipTokenSlots();
+
+int SatipToVdrParameter(const char* key, std::string_view value) {
+  std::string_view k(key);
+  uint8_t i = SatipTokenIndex[SatipTokenHash(SatipTokenSeed, k, value) & (SatipTokenSlots - 1)];
+  if ((i != SatipTokenUnused) and (SatipTokens[i].key == k) and (SatipTokens[i].value == value))
+     return SatipTokens[i].vdrValue;
+  return 999;
+}
+
+class cSatipUrlStrings {
+private:
+  enum { eDirectSize = 32 };
+  const tSatipParameterMap* map;
+  bool direct;
+  std::array<const char*, eDirectSize> strings;
+public:
+  constexpr cSatipUrlStrings(const tSatipParameterMap* m) : map(m), direct(true), strings() {
+    for(auto it = map; it->satipString; it++)
+       if ((it->driverValue < 0) or (it->driverValue >= eDirectSize))
+          direct = false;
+       else if (!strings[it->driverValue]) // first entry wins, as in the maps
+          strings[it->driverValue] = it->satipString;
+    }
+  constexpr const char* Get(int value) const {
+    if (direct)
+       return ((value >= 0) and (value < eDirectSize) and strings[value]) ? strings[value] : "";
+    for(auto it = map; it->satipString; it++)
+       if (it->driverValue == value)
+          return it->satipString;
+    return "";
+    }
+};
+
+static constexpr cSatipUrlStrings SatipBandwidthUrl(SatipBandwidthValues);
+static constexpr cSatipUrlStrings SatipPilotUrl(SatipPilotValues);
+static constexpr cSatipUrlStrings SatipSisoMisoUrl(SatipSisoMisoValues);
+static constexpr cSatipUrlStrings SatipCodeRateUrl(SatipCodeRateValues);
+static constexpr cSatipUrlStrings SatipModulationUrl(SatipModulationValues);
+static constexpr cSatipUrlStrings SatipSystemSatUrl(SatipSystemValuesSat);
+static constexpr cSatipUrlStrings SatipSystemTerrestrialUrl(SatipSystemValuesTerrestrial);
+static constexpr cSatipUrlStrings SatipSystemCableUrl(SatipSystemValuesCable);
+static constexpr cSatipUrlStrings SatipSystemAtscUrl(SatipSystemValuesAtsc);
+static constexpr cSatipUrlStrings SatipTransmissionUrl(SatipTransmissionValues);
+static constexpr cSatipUrlStrings SatipGuardUrl(SatipGuardValues);
+static constexpr cSatipUrlStrings SatipRollOffUrl(SatipRollOffValues);
+static constexpr cSatipUrlStrings SatipInversionUrl(SatipInversionValues);
+
+// --- GetTransponderUrlParameters --------------------------------------------
+
+static void UrlAppend(char* buf, size_t size, size_t& len, const char* fmt, ...) __attribute__ ((format (printf, 4, 5)));
+static void UrlAppend(char* buf, size_t size, size_t& len, const char* fmt, ...) {
+  if (len >= size)
+     return;
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(buf + len, size - len, fmt, ap);
+  va_end(ap);
+  if (n > 0)
+     len = std::min(len + n, size - 1);
+}
 
-     auto check = [](std::string s, char Type, int delsys) {
-        char Delivery[3] = { (char) ('1' + delsys), '*', 0 };
-        return ((s.find(Type) != std::string::npos) and
-                (s.find_first_of(Delivery) != std::string::npos));
+std::string GetTransponderUrlParameters(const cChannel* channel) {
+  if (channel) {
+     auto check = [](const char* s, char Type, int delsys) {
+        return (strchr(s, Type) and (strchr(s, '1' + delsys) or strchr(s, '*')));
         };
 
-     std::stringstream ss;
+     char buf[256];
+     size_t len = 0;
      cDvbTransponderParameters dtp(channel->Parameters());
      int DataSlice = 0;
      int C2TuningFrequencyType = 0;
@@ -198,9 +300,9 @@ std::string GetTransponderUrlParameters(const cChannel* channel) {
      while(freq > 20000.0f) // MHz
         freq /= 1000.0f;
 
-
-
+     buf[0] = 0;
      #define ST(s) if (check(s, type, dtp.System()))
+     #define URL(x...) UrlAppend(buf, sizeof(buf), len, x)
 
      ST(" S 1") {
         /* comply with
@@ -212,41 +314,41 @@ std::string GetTransponderUrlParameters(const cChannel* channel) {
         dtp.SetRollOff(ROLLOFF_35);
         }
 
-     if (fe)          ss << "&fe="    << fe;
-     ST("  S *")      ss << "&src="   << ((src > 0) && (src <= 255) ? src : 1);
-     if (freq > 0.0f) ss << "&freq="  << PrintFloat(freq);
-     ST("  S *")      ss << "&pol="   << (char) tolower(dtp.Polarization());
-     ST("  S *")      ss << PrintUrlString(dtp.RollOff(), SatipRollOffValues);
-     ST(" C  2")      ss << "&c2tft=" << C2TuningFrequencyType;
-     ST("   T*")      ss << PrintUrlString(dtp.Bandwidth(),    SatipBandwidthValues);
-     ST(" C  2")      ss << PrintUrlString(dtp.Bandwidth(),    SatipBandwidthValues);
-     ST("  S *")      ss << PrintUrlString(dtp.System(),       SatipSystemValuesSat);
-     ST(" C  *")      ss << PrintUrlString(dtp.System(),       SatipSystemValuesCable);
-     ST("   T*")      ss << PrintUrlString(dtp.System(),       SatipSystemValuesTerrestrial);
-     ST("A   *")      ss << PrintUrlString(dtp.System(),       SatipSystemValuesAtsc);
-     ST("   T*")      ss << PrintUrlString(dtp.Transmission(), SatipTransmissionValues);
-     ST("  S *")      ss << PrintUrlString(dtp.Modulation(),   SatipModulationValues);
-     ST("   T*")      ss << PrintUrlString(dtp.Modulation(),   SatipModulationValues);
-     ST(" C  1")      ss << PrintUrlString(dtp.Modulation(),   SatipModulationValues);
-     ST("A   *")      ss << PrintUrlString(dtp.Modulation(),   SatipModulationValues);
-     ST("  S *")      ss << PrintUrlString(dtp.Pilot(),        SatipPilotValues);
-     ST("  S *")      ss << "&sr="    << channel->Srate();
-     ST(" C  1")      ss << "&sr="    << channel->Srate();
-     ST("   T*")      ss << PrintUrlString(dtp.Guard(),        SatipGuardValues);
-     ST(" CST*")      ss << PrintUrlString(dtp.CoderateH(),    SatipCodeRateValues);
-     ST(" C  2")      ss << "&ds="    << DataSlice;
-     ST(" C T2")      ss << "&plp="   << dtp.StreamId();
-     ST("   T2")      ss << "&t2id="  << dtp.T2SystemId();
-     ST("   T2")      ss << PrintUrlString(dtp.SisoMiso(),     SatipSisoMisoValues);
-     ST(" C  1")      ss << PrintUrlString(dtp.Inversion(),    SatipInversionValues);
-     ST("A   *")      ss << PrintUrlString(dtp.Inversion(),    SatipInversionValues);
+     if (fe)          URL("&fe=%d", fe);
+     ST("  S *")      URL("&src=%d", (src > 0) && (src <= 255) ? src : 1);
+     if (freq > 0.0f) URL("&freq=%.3f", freq);
+     ST("  S *")      URL("&pol=%c", tolower(dtp.Polarization()));
+     ST("  S *")      URL("%s", SatipRollOffUrl.Get(dtp.RollOff()));
+     ST(" C  2")      URL("&c2tft=%d", C2TuningFrequencyType);
+     ST("   T*")      URL("%s", SatipBandwidthUrl.Get(dtp.Bandwidth()));
+     ST(" C  2")      URL("%s", SatipBandwidthUrl.Get(dtp.Bandwidth()));
+     ST("  S *")      URL("%s", SatipSystemSatUrl.Get(dtp.System()));
+     ST(" C  *")      URL("%s", SatipSystemCableUrl.Get(dtp.System()));
+     ST("   T*")      URL("%s", SatipSystemTerrestrialUrl.Get(dtp.System()));
+     ST("A   *")      URL("%s", SatipSystemAtscUrl.Get(dtp.System()));
+     ST("   T*")      URL("%s", SatipTransmissionUrl.Get(dtp.Transmission()));
+     ST("  S *")      URL("%s", SatipModulationUrl.Get(dtp.Modulation()));
+     ST("   T*")      URL("%s", SatipModulationUrl.Get(dtp.Modulation()));
+     ST(" C  1")      URL("%s", SatipModulationUrl.Get(dtp.Modulation()));
+     ST("A   *")      URL("%s", SatipModulationUrl.Get(dtp.Modulation()));
+     ST("  S *")      URL("%s", SatipPilotUrl.Get(dtp.Pilot()));
+     ST("  S *")      URL("&sr=%d", channel->Srate());
+     ST(" C  1")      URL("&sr=%d", channel->Srate());
+     ST("   T*")      URL("%s", SatipGuardUrl.Get(dtp.Guard()));
+     ST(" CST*")      URL("%s", SatipCodeRateUrl.Get(dtp.CoderateH()));
+     ST(" C  2")      URL("&ds=%d", DataSlice);
+     ST(" C T2")      URL("&plp=%d", dtp.StreamId());
+     ST("   T2")      URL("&t2id=%d", dtp.T2SystemId());
+     ST("   T2")      URL("%s", SatipSisoMisoUrl.Get(dtp.SisoMiso()));
+     ST(" C  1")      URL("%s", SatipInversionUrl.Get(dtp.Inversion()));
+     ST("A   *")      URL("%s", SatipInversionUrl.Get(dtp.Inversion()));
+     #undef URL
      #undef ST
 
-     result = ss.str();
-     if (result.size() > 0)
-        result.erase(0,1); // skip leading '&'
+     if (len > 0)
+        return std::string(buf + 1, len - 1); // skip leading '&'
      }
-  return result;
+  return "";
 }
 
 std::string GetTnrUrlParameters(const cChannel* channel) {
@@ -8,8 +8,9 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 
 std::string GetTransponderUrlParameters(const cChannel* channel);
 std::string GetTnrUrlParameters(const cChannel* channel);
-int SatipToVdrParameter(std::string param);
+int SatipToVdrParameter(const char* key, std::string_view value);
 int SrcIdToSource(int pos);
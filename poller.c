@@ -41,7 +41,8 @@ void cSatipPoller::Destroy(void)
 cSatipPoller::cSatipPoller()
 : cThread("SATIP poller"),
   mutexM(),
-  fdM(epoll_create(eMaxFileDescriptors))
+  fdM(epoll_create(eMaxFileDescriptors)),
+  pollersM()
 {
   dbg_funcname("%s", __PRETTY_FUNCTION__);
 }
@@ -82,7 +83,10 @@ void cSatipPoller::Action(void)
         ERROR_IF_FUNC((nfds == -1 && errno != EINTR), "epoll_wait() failed", break, ;);
         for (int i = 0; i < nfds; ++i) {
             cSatipPollerIf* poll = reinterpret_cast<cSatipPollerIf *>(events[i].data.ptr);
-            if (poll) {
+            // Unregister() waits for the processing, and the interface may
+            // have been unregistered after epoll_wait() already
+            cMutexLock MutexLock(&mutexM);
+            if (poll && pollersM.count(poll)) {
                uint64_t elapsed;
                cTimeMs processing(0);
                poll->Process();
@@ -106,6 +110,7 @@ bool cSatipPoller::Register(cSatipPollerIf &pollerP)
   ev.events = EPOLLIN | EPOLLET;
   ev.data.ptr = &pollerP;
   ERROR_IF_RET(epoll_ctl(fdM, EPOLL_CTL_ADD, pollerP.GetFd(), &ev) == -1, "epoll_ctl(EPOLL_CTL_ADD) failed", return false);
+  pollersM.insert(&pollerP);
   dbg_funcname("%s Added interface fd=%d", __PRETTY_FUNCTION__, pollerP.GetFd());
 
   return true;
@@ -115,6 +120,7 @@ bool cSatipPoller::Unregister(cSatipPollerIf &pollerP)
 {
   dbg_funcname("%s fd=%d", __PRETTY_FUNCTION__, pollerP.GetFd());
   cMutexLock MutexLock(&mutexM);
+  pollersM.erase(&pollerP);
   ERROR_IF_RET((epoll_ctl(fdM, EPOLL_CTL_DEL, pollerP.GetFd(), NULL) == -1), "epoll_ctl(EPOLL_CTL_DEL) failed", return false);
   dbg_funcname("%s Removed interface fd=%d", __PRETTY_FUNCTION__, pollerP.GetFd());
 
@@ -8,6 +8,7 @@
 #ifndef __SATIP_POLLER_H
 #define __SATIP_POLLER_H
 
+#include <set>
 #include <vdr/thread.h>
 #include <vdr/tools.h>
 
@@ -21,6 +22,7 @@ private:
   static cSatipPoller *instanceS;
   cMutex mutexM;
   int fdM;
+  std::set<cSatipPollerIf *> pollersM;
   void Activate(void);
   void Deactivate(void);
   // constructor
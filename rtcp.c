@@ -87,7 +87,7 @@ void cSatipRtcp::Process(void)
      while ((length = Read(bufferM, bufferLenM)) > 0) {
            int offset = GetApplicationOffset(bufferM, &length);
            if (offset >= 0)
-              tunerM.ProcessApplicationData(bufferM + offset, length);
+              tunerM.ProcessApplicationData(bufferM + offset, length, true);
            }
      }
 }
@@ -98,7 +98,7 @@ void cSatipRtcp::Process(unsigned char *dataP, int lengthP)
   if (dataP && lengthP > 0) {
      int offset = GetApplicationOffset(dataP, &lengthP);
      if (offset >= 0)
-        tunerM.ProcessApplicationData(dataP + offset, lengthP);
+        tunerM.ProcessApplicationData(dataP + offset, lengthP, true);
      }
 }
 
@@ -104,7 +104,7 @@ int cSatipRtp::GetHeaderLength(unsigned char *bufferP, unsigned int lengthP)
            headerlen = -1;
            }
         // Check that rtp is version 2 and payload contains multiple of TS packet data
-        else if ((v != 2) || (((lengthP - headerlen) % TS_SIZE) != 0) || (bufferP[headerlen] != TS_SYNC_BYTE)) {
+        else if ((v != 2) || (((lengthP - headerlen) % TS_SIZE) != 0) || !ts_sync_valid(bufferP + headerlen, lengthP - headerlen)) {
            dbg_rtp_packet("%s (%d) Received incorrect RTP packet #%d v=%d len=%d sync=0x%02X [device %d]", __PRETTY_FUNCTION__,
                    lengthP, seq, v, headerlen, bufferP[headerlen], tunerM.GetId());
            headerlen = -1;
@@ -341,7 +341,7 @@ bool cSatipRtsp::Describe(const char *uriP)
      SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_WRITEFUNCTION, NULL);
      SATIP_CURL_EASY_SETOPT(handleM, CURLOPT_WRITEDATA, NULL);
      if (dataBufferM.Size() > 0) {
-        tunerM.ProcessApplicationData((u_char *)dataBufferM.Data(), dataBufferM.Size());
+        tunerM.ProcessApplicationData((u_char *)dataBufferM.Data(), dataBufferM.Size(), false);
         dataBufferM.Reset();
         }
 
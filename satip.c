@@ -12,9 +12,12 @@
 #include "config.h"
 #include "device.h"
 #include "discover.h"
+#include "eventloop.h"
 #include "log.h"
 #include "poller.h"
+#include "sectioncache.h"
 #include "setup.h"
+#include "tunecache.h"
 
 #if defined(LIBCURL_VERSION_NUM) && LIBCURL_VERSION_NUM < 0x072400
 #warning "CURL version >= 7.36.0 is recommended"
@@ -93,6 +96,8 @@ const char *cPluginSatip::CommandLineHelp(void)
          "                                                       0x20: Support the CI TNR protocol extension\n"
          "                                                       0x40: Fix auto-detection of pilot tones bug\n"
          "                                                       0x80: Fix re-tuning bug by teardowning a session\n"
+         "                                                      0x100: Request the full transponder (pids=all)\n"
+         "                                                             and filter the pids locally\n"
          "  -D, --detach                  set the detached mode on\n"
          "  -S, --single                  set the single model server mode on\n"
          "  -n, --noquirks                disable autodetection of the server quirks\n"
@@ -166,6 +171,8 @@ bool cPluginSatip::Initialize(void)
      error("Unable to initialize CURL");
   cSatipPoller::GetInstance()->Initialize();
   cSatipDiscover::GetInstance()->Initialize(serversM);
+  cSatipTuneCache::GetInstance()->Initialize();
+  cSatipEventLoop::Initialize(SatipConfig.GetEventLoops());
   return cSatipDevice::Initialize(deviceCountM);
 }
 
@@ -189,7 +196,10 @@ void cPluginSatip::Stop(void)
   dbg_funcname("%s", __PRETTY_FUNCTION__);
   // Stop any background activities the plugin is performing.
   cSatipDevice::Shutdown();
+  cSatipTuneCache::GetInstance()->Destroy();
+  cSatipSectionCache::GetInstance()->Destroy();
   cSatipDiscover::GetInstance()->Destroy();
+  cSatipEventLoop::Destroy();
   cSatipPoller::GetInstance()->Destroy();
   curl_global_cleanup();
 }
@@ -198,6 +208,7 @@ void cPluginSatip::Housekeeping(void)
 {
   dbg_funcname_ext("%s", __PRETTY_FUNCTION__);
   // Perform any cleanup or other regular tasks.
+  cSatipDevice::Housekeeping();
 }
 
 void cPluginSatip::MainThreadHook(void)
@@ -400,6 +411,16 @@ bool cPluginSatip::SetupParse(const char *nameP, const char *valueP)
      SatipConfig.SetCIExtension(atoi(valueP));
   else if (!strcasecmp(nameP, "EnableFrontendReuse"))
      SatipConfig.SetFrontendReuse(atoi(valueP));
+  else if (!strcasecmp(nameP, "EnableStreamSharing"))
+     SatipConfig.SetStreamSharing(atoi(valueP));
+  else if (!strcasecmp(nameP, "DropUnrequested"))
+     SatipConfig.SetDropUnrequested(atoi(valueP));
+  else if (!strcasecmp(nameP, "SectionRefresh"))
+     SatipConfig.SetSectionRefresh(atoi(valueP));
+  else if (!strcasecmp(nameP, "EventLoops"))
+     SatipConfig.SetEventLoops(atoi(valueP));
+  else if (!strcasecmp(nameP, "IdleRelease"))
+     SatipConfig.SetIdleRelease(atoi(valueP));
   else if (!strcasecmp(nameP, "CICAM")) {
      int Cicams[MAX_CICAM_COUNT];
      for (unsigned int i = 0; i < ELEMENTS(Cicams); ++i)
@@ -428,6 +449,8 @@ bool cPluginSatip::SetupParse(const char *nameP, const char *valueP)
      }
   else if (!strcasecmp(nameP, "TransportMode"))
      SatipConfig.SetTransportMode(atoi(valueP));
+  else if (!strcasecmp(nameP, "AssignPolicy"))
+     SatipConfig.SetAssignPolicy(atoi(valueP));
   else
      return false;
   return true;
@@ -446,7 +469,7 @@ const char **cPluginSatip::SVDRPHelpPages(void)
     "INFO [ <page> ] [ <card index> ]\n"
     "    Prints SAT>IP device information and statistics.\n"
     "    The output can be narrowed using optional \"page\""
-    "    option: 1=general 2=pids 3=section filters.\n",
+    "    option: 1=general 2=pids and continuity 3=section filters.\n",
     "MODE\n"
     "    Toggles between bit or byte information mode.\n",
     "LIST\n"
@@ -0,0 +1,172 @@
+/*
+ * sectioncache.c: SAT>IP plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include "common.h"
+#include "log.h"
+#include "sectioncache.h"
+#include "sectionfilter.h"
+
+cSatipSectionCache *cSatipSectionCache::instanceS = NULL;
+
+cSatipSectionCache *cSatipSectionCache::GetInstance(void)
+{
+  if (!instanceS)
+     instanceS = new cSatipSectionCache();
+  return instanceS;
+}
+
+void cSatipSectionCache::Destroy(void)
+{
+  dbg_funcname("%s", __PRETTY_FUNCTION__);
+  if (instanceS)
+     instanceS->Invalidate();
+}
+
+cSatipSectionCache::cSatipSectionCache()
+: mutexM(),
+  transpondersM(),
+  useCountM(0)
+{
+  dbg_funcname("%s", __PRETTY_FUNCTION__);
+}
+
+cSatipSectionCache::~cSatipSectionCache()
+{
+  dbg_funcname("%s", __PRETTY_FUNCTION__);
+}
+
+uint64_t cSatipSectionCache::Key(int sourceP, int transponderP)
+{
+  // zero is reserved for an unknown transponder
+  return ((uint64_t)(uint32_t)sourceP << 32) | (uint32_t)transponderP;
+}
+
+uint64_t cSatipSectionCache::SectionKey(uint16_t pidP, const uint8_t *dataP)
+{
+  return ((uint64_t)pidP << 40) | ((uint64_t)dataP[0] << 32) | ((uint64_t)dataP[3] << 24) | ((uint32_t)dataP[4] << 16) |
+         ((uint32_t)((dataP[5] >> 1) & 0x1F) << 8) | dataP[6];
+}
+
+bool cSatipSectionCache::IsCacheable(uint16_t pidP, const uint8_t *dataP, int lengthP)
+{
+  // Only current sections with the long syntax
+  if ((lengthP < eMinSectionSize) || !(dataP[1] & 0x80) || !(dataP[5] & 0x01))
+     return false;
+  switch (dataP[0]) {
+    case 0x00: // PAT
+         return (pidP == 0x00);
+    case 0x02: // PMT
+         return true;
+    case 0x40: // NIT actual
+    case 0x41: // NIT other
+         return (pidP == 0x10);
+    case 0x42: // SDT actual
+    case 0x46: // SDT other
+         return (pidP == 0x11);
+    default:
+         break;
+    }
+  return false;
+}
+
+void cSatipSectionCache::Tuned(uint64_t transponderP)
+{
+  cMutexLock MutexLock(&mutexM);
+  std::map<uint64_t, cTransponder>::iterator t = transpondersM.find(transponderP);
+  // The next PAT tells whether the cached tables are still valid
+  if (t != transpondersM.end())
+     t->second.tsidConfirmed = false;
+}
+
+void cSatipSectionCache::Store(uint64_t transponderP, uint16_t pidP, const uint8_t *dataP, int lengthP)
+{
+  if (!transponderP || !IsCacheable(pidP, dataP, lengthP))
+     return;
+  cMutexLock MutexLock(&mutexM);
+  std::map<uint64_t, cTransponder>::iterator t = transpondersM.find(transponderP);
+  if (t == transpondersM.end()) {
+     // Evict the least recently used transponder
+     if (transpondersM.size() >= eMaxTransponders) {
+        std::map<uint64_t, cTransponder>::iterator oldest = transpondersM.begin();
+        for (std::map<uint64_t, cTransponder>::iterator it = transpondersM.begin(); it != transpondersM.end(); ++it) {
+            if (it->second.lastUsed < oldest->second.lastUsed)
+               oldest = it;
+            }
+        transpondersM.erase(oldest);
+        }
+     t = transpondersM.insert(std::make_pair(transponderP, cTransponder())).first;
+     }
+  cTransponder &transponder = t->second;
+  transponder.lastUsed = ++useCountM;
+  std::map<uint64_t, std::vector<uint8_t> > &sections = transponder.sections;
+  int tsid = (dataP[3] << 8) | dataP[4];
+  if (dataP[0] == 0x00) {
+     if (!transponder.tsidConfirmed) {
+        // Another transport stream on this frequency: nothing cached is valid
+        if ((transponder.tsid >= 0) && (transponder.tsid != tsid))
+           sections.clear();
+        transponder.tsid = tsid;
+        transponder.tsidConfirmed = true;
+        }
+     else if (transponder.tsid != tsid)
+        return;
+     }
+  else if ((dataP[0] == 0x42) && (!transponder.tsidConfirmed || (transponder.tsid != tsid)))
+     return;
+  uint64_t key = SectionKey(pidP, dataP);
+  // Drop the sections of the other versions of this table
+  uint64_t table = key & ~0xFFFFULL;
+  for (std::map<uint64_t, std::vector<uint8_t> >::iterator it = sections.lower_bound(table); (it != sections.end()) && (it->first <= (table | 0xFFFF)); ) {
+      if ((it->first & ~0xFFULL) != (key & ~0xFFULL))
+         sections.erase(it++);
+      else
+         ++it;
+      }
+  std::map<uint64_t, std::vector<uint8_t> >::iterator s = sections.find(key);
+  if (s != sections.end()) {
+     // Unchanged repetitions are by far the most common case
+     if ((s->second.size() == (size_t)lengthP) && !memcmp(&s->second[0], dataP, lengthP))
+        return;
+     s->second.assign(dataP, dataP + lengthP);
+     }
+  else if (sections.size() < eMaxSectionsPerTransponder)
+     sections[key].assign(dataP, dataP + lengthP);
+  else
+     return;
+  // Drop the sections beyond the last section number of the new version
+  std::map<uint64_t, std::vector<uint8_t> >::iterator it = sections.upper_bound(key | 0xFF);
+  sections.erase(sections.lower_bound((key & ~0xFFULL) + dataP[7] + 1), it);
+  dbg_sectionfilter("%s pid=%d tid=0x%02X section=%d version=%d", __PRETTY_FUNCTION__, pidP, dataP[0], dataP[6], (dataP[5] >> 1) & 0x1F);
+}
+
+int cSatipSectionCache::Prime(uint64_t transponderP, cSatipSectionFilter *filterP, int handleP)
+{
+  if (!transponderP || !filterP)
+     return 0;
+  cMutexLock MutexLock(&mutexM);
+  std::map<uint64_t, cTransponder>::iterator t = transpondersM.find(transponderP);
+  if (t == transpondersM.end())
+     return 0;
+  t->second.lastUsed = ++useCountM;
+  int count = 0;
+  std::map<uint64_t, std::vector<uint8_t> > &sections = t->second.sections;
+  uint64_t pid = filterP->GetPid();
+  for (std::map<uint64_t, std::vector<uint8_t> >::iterator it = sections.lower_bound(pid << 40); (it != sections.end()) && ((it->first >> 40) == pid); ++it) {
+      if (filterP->Queue(&it->second[0], (int)it->second.size(), handleP))
+         ++count;
+      }
+  if (count)
+     dbg_sectionfilter("%s pid=%d primed with %d sections", __PRETTY_FUNCTION__, filterP->GetPid(), count);
+  return count;
+}
+
+void cSatipSectionCache::Invalidate(void)
+{
+  dbg_funcname("%s", __PRETTY_FUNCTION__);
+  cMutexLock MutexLock(&mutexM);
+  transpondersM.clear();
+}
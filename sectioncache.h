@@ -0,0 +1,64 @@
+/*
+ * sectioncache.h: SAT>IP plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __SATIP_SECTIONCACHE_H
+#define __SATIP_SECTIONCACHE_H
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+
+#include <vdr/thread.h>
+#include <vdr/tools.h>
+
+class cSatipSectionFilter;
+
+// --- cSatipSectionCache -----------------------------------------------------
+
+// The latest complete PAT, PMT, NIT and SDT sections of recently tuned
+// transponders, used for priming newly opened section filters.
+class cSatipSectionCache {
+private:
+  enum {
+    eMaxTransponders           = 16,
+    eMaxSectionsPerTransponder = 512,
+    eMinSectionSize            = 12
+  };
+  struct cTransponder {
+    uint64_t lastUsed;
+    // the transport stream id of the PAT and whether it has been seen
+    // since the transponder was tuned last time
+    int tsid;
+    bool tsidConfirmed;
+    // key: pid, table id, table id extension, version and section number
+    std::map<uint64_t, std::vector<uint8_t> > sections;
+    cTransponder() : lastUsed(0), tsid(-1), tsidConfirmed(false) {}
+  };
+  static cSatipSectionCache *instanceS;
+  cMutex mutexM;
+  std::map<uint64_t, cTransponder> transpondersM;
+  uint64_t useCountM;
+  static uint64_t SectionKey(uint16_t pidP, const uint8_t *dataP);
+  // constructor
+  cSatipSectionCache();
+  // to prevent copy constructor and assignment
+  cSatipSectionCache(const cSatipSectionCache&);
+  cSatipSectionCache& operator=(const cSatipSectionCache&);
+
+public:
+  static cSatipSectionCache *GetInstance(void);
+  static void Destroy(void);
+  static uint64_t Key(int sourceP, int transponderP);
+  static bool IsCacheable(uint16_t pidP, const uint8_t *dataP, int lengthP);
+  virtual ~cSatipSectionCache();
+  void Tuned(uint64_t transponderP);
+  void Store(uint64_t transponderP, uint16_t pidP, const uint8_t *dataP, int lengthP);
+  int Prime(uint64_t transponderP, cSatipSectionFilter *filterP, int handleP = -1);
+  void Invalidate(void);
+};
+
+#endif // __SATIP_SECTIONCACHE_H
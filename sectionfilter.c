@@ -5,11 +5,16 @@
  *
  */
 
+#include <algorithm>
+#include <cinttypes>
+
 #include "config.h"
+#include "eventloop.h"
 #include "log.h"
+#include "sectioncache.h"
 #include "sectionfilter.h"
 
-cSatipSectionFilter::cSatipSectionFilter(int deviceIndexP, uint16_t pidP, uint8_t tidP, uint8_t maskP)
+cSatipSectionFilter::cSatipSectionFilter(int deviceIndexP, uint16_t pidP, const uint8_t *valueP, const uint8_t *maskP, const uint8_t *modeP)
 : pusiSeenM(0),
   feedCcM(0),
   doneqM(0),
@@ -18,61 +23,157 @@ cSatipSectionFilter::cSatipSectionFilter(int deviceIndexP, uint16_t pidP, uint8_
   secLenM(0),
   tsFeedpM(0),
   pidM(pidP),
-  ringBufferM(new cRingBufferFrame(eDmxMaxSectionCount * eDmxMaxSectionSize)),
-  deviceIndexM(deviceIndexP)
+  classM(scSi),
+  transponderM(0),
+  sectionsM(),
+  firstSectionM(0),
+  storedBytesM(0),
+  storedBytesHighM(0),
+  storedSectionsHighM(0),
+  grownM(false),
+  lastPutM(0),
+  deviceIndexM(deviceIndexP),
+  handlesM()
 {
-  dbg_funcname_ext("%s (%d, %d, %d, %d) [device %d]", __PRETTY_FUNCTION__, deviceIndexM, pidM, tidP, maskP, deviceIndexM);
-  int i;
-
-  memset(secBufBaseM,     0, sizeof(secBufBaseM));
-  memset(filterValueM,    0, sizeof(filterValueM));
-  memset(filterMaskM,     0, sizeof(filterMaskM));
-  memset(filterModeM,     0, sizeof(filterModeM));
-  memset(maskAndModeM,    0, sizeof(maskAndModeM));
-  memset(maskAndNotModeM, 0, sizeof(maskAndNotModeM));
-
-  filterValueM[0] = tidP;
-  filterMaskM[0] = maskP;
-
-  // Invert the filter
-  for (i = 0; i < eDmxMaxFilterSize; ++i)
-      filterValueM[i] ^= 0xFF;
+  dbg_funcname_ext("%s (%d, %d, %d, %d) [device %d]", __PRETTY_FUNCTION__, deviceIndexM, pidM, valueP[0], maskP[0], deviceIndexM);
 
+  // As in the Linux DVB API, the masked bits with mode 0 must be equal
+  // and at least one of the masked bits with mode 1 must differ
   uint8_t doneq = 0;
-  for (i = 0; i < eDmxMaxFilterSize; ++i) {
-      uint8_t mode = filterModeM[i];
-      uint8_t mask = filterMaskM[i];
-      maskAndModeM[i] = (uint8_t)(mask & mode);
-      maskAndNotModeM[i] = (uint8_t)(mask & ~mode);
+  for (int i = 0; i < eDmxMaxFilterSize; ++i) {
+      filterValueM[i] = valueP[i];
+      maskAndModeM[i] = (uint8_t)(maskP[i] & ~modeP[i]);
+      maskAndNotModeM[i] = (uint8_t)(maskP[i] & modeP[i]);
       doneq |= maskAndNotModeM[i];
       }
   doneqM = doneq ? 1 : 0;
 
-  // Create sockets
-  socketM[0] = socketM[1] = -1;
-  if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, socketM) != 0) {
+  // A zap waits for the PAT, CAT and PMT, the EIT is only for the guide
+  uint8_t tid = (uint8_t)(valueP[0] & maskP[0]);
+  if ((pidM == 0x00) || (pidM == 0x01) || ((maskP[0] == 0xFF) && (tid == 0x02)))
+     classM = scPsi;
+  else if ((pidM == 0x12) || ((maskP[0] == 0xFF) && (tid >= 0x4E) && (tid <= 0x6F)))
+     classM = scEit;
+}
+
+cSatipSectionFilter::~cSatipSectionFilter()
+{
+  dbg_funcname_ext("%s pid=%d [device %d]", __PRETTY_FUNCTION__, pidM, deviceIndexM);
+  while (!handlesM.empty())
+        RemoveHandle(handlesM.back().socket[0]);
+  secBufM = NULL;
+}
+
+int cSatipSectionFilter::AddHandle(void)
+{
+  handleStruct handle;
+  // Deliver the sections still stored for the other handles too
+  handle.cursor = firstSectionM;
+  handle.socket[0] = handle.socket[1] = -1;
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, handle.socket) != 0) {
      char tmp[64];
      error("Opening section filter sockets failed (device=%d pid=%d): %s", deviceIndexM, pidM, strerror_r(errno, tmp, sizeof(tmp)));
+     return -1;
      }
-  else if ((fcntl(socketM[0], F_SETFL, O_NONBLOCK) != 0) || (fcntl(socketM[1], F_SETFL, O_NONBLOCK) != 0)) {
+  if ((fcntl(handle.socket[0], F_SETFL, O_NONBLOCK) != 0) || (fcntl(handle.socket[1], F_SETFL, O_NONBLOCK) != 0)) {
      char tmp[64];
      error("Setting section filter socket to non-blocking mode failed (device=%d pid=%d): %s", deviceIndexM, pidM, strerror_r(errno, tmp, sizeof(tmp)));
+     close(handle.socket[0]);
+     close(handle.socket[1]);
+     return -1;
      }
+  handlesM.push_back(handle);
+  return handle.socket[0];
 }
 
-cSatipSectionFilter::~cSatipSectionFilter()
+bool cSatipSectionFilter::RemoveHandle(int fdP)
 {
-  dbg_funcname_ext("%s pid=%d [device %d]", __PRETTY_FUNCTION__, pidM, deviceIndexM);
-  int tmp = socketM[1];
-  socketM[1] = -1;
-  if (tmp >= 0)
-     close(tmp);
-  tmp = socketM[0];
-  socketM[0] = -1;
-  if (tmp >= 0)
-     close(tmp);
-  secBufM = NULL;
-  DELETENULL(ringBufferM);
+  for (std::vector<handleStruct>::iterator it = handlesM.begin(); it != handlesM.end(); ++it) {
+      if (it->socket[0] == fdP) {
+         close(it->socket[1]);
+         close(it->socket[0]);
+         handlesM.erase(it);
+         Trim();
+         return true;
+         }
+      }
+  return false;
+}
+
+bool cSatipSectionFilter::HasHandle(int fdP) const
+{
+  for (std::vector<handleStruct>::const_iterator it = handlesM.begin(); it != handlesM.end(); ++it) {
+      if (it->socket[0] == fdP)
+         return true;
+      }
+  return false;
+}
+
+bool cSatipSectionFilter::Equals(uint16_t pidP, const uint8_t *valueP, const uint8_t *maskP, const uint8_t *modeP) const
+{
+  if (pidP != pidM)
+     return false;
+  for (int i = 0; i < eDmxMaxFilterSize; ++i) {
+      uint8_t mask = (uint8_t)(maskAndModeM[i] | maskAndNotModeM[i]);
+      if ((mask != maskP[i]) || (maskAndNotModeM[i] != (uint8_t)(maskP[i] & modeP[i])) ||
+          ((filterValueM[i] & mask) != (valueP[i] & maskP[i])))
+         return false;
+      }
+  return true;
+}
+
+bool cSatipSectionFilter::Put(const uint8_t *dataP, int lengthP)
+{
+  if (handlesM.empty())
+     return false;
+  // A stalled handle mustn't block the others: it loses its oldest sections
+  if (storedBytesM + lengthP > eDmxMaxStoredBytes) {
+     while (!sectionsM.empty() && (storedBytesM + lengthP > eDmxMaxStoredBytes)) {
+           storedBytesM -= (long)sectionsM.front().data.size();
+           sectionsM.pop_front();
+           ++firstSectionM;
+           }
+     for (std::vector<handleStruct>::iterator it = handlesM.begin(); it != handlesM.end(); ++it) {
+         if (it->cursor < firstSectionM)
+            it->cursor = firstSectionM;
+         }
+     }
+  lastPutM = cTimeMs::Now();
+  sectionsM.push_back(sectionStruct());
+  sectionsM.back().data.assign(dataP, dataP + lengthP);
+  sectionsM.back().timestamp = lastPutM;
+  storedBytesM += lengthP;
+  if (storedBytesM > storedBytesHighM)
+     storedBytesHighM = storedBytesM;
+  if ((int)sectionsM.size() > storedSectionsHighM)
+     storedSectionsHighM = (int)sectionsM.size();
+  if (sectionsM.size() > 1)
+     grownM = true;
+  return true;
+}
+
+void cSatipSectionFilter::Shrink(void)
+{
+  // Give the memory of a burst back once the queue has been idle
+  if (grownM && sectionsM.empty() && (cTimeMs::Now() - lastPutM > eIdleShrinkTimeoutMs)) {
+     std::deque<sectionStruct>().swap(sectionsM);
+     grownM = false;
+     }
+}
+
+void cSatipSectionFilter::Trim(void)
+{
+  // Release the sections already delivered to every handle
+  uint64_t oldest = firstSectionM + sectionsM.size();
+  for (std::vector<handleStruct>::const_iterator it = handlesM.begin(); it != handlesM.end(); ++it) {
+      if (it->cursor < oldest)
+         oldest = it->cursor;
+      }
+  while (firstSectionM < oldest) {
+        storedBytesM -= (long)sectionsM.front().data.size();
+        sectionsM.pop_front();
+        ++firstSectionM;
+        }
 }
 
 inline uint16_t cSatipSectionFilter::GetLength(const uint8_t *dataP)
@@ -83,30 +184,93 @@ inline uint16_t cSatipSectionFilter::GetLength(const uint8_t *dataP)
 void cSatipSectionFilter::New(void)
 {
   tsFeedpM = secBufpM = secLenM = 0;
-  secBufM = secBufBaseM;
+  secBufM = secBufBaseM.empty() ? NULL : &secBufBaseM[0];
 }
 
-int cSatipSectionFilter::Filter(void)
+inline bool cSatipSectionFilter::HasCrc(const uint8_t *dataP, int lengthP)
 {
-  if (secBufM) {
-     int i;
-     uint8_t neq = 0;
+  // The long syntax and the TOT end with a CRC32
+  return (lengthP >= 7) && ((dataP[1] & 0x80) || (dataP[0] == 0x73));
+}
 
-     for (i = 0; i < eDmxMaxFilterSize; ++i) {
-         uint8_t calcxor = (uint8_t)(filterValueM[i] ^ secBufM[i]);
-         if (maskAndModeM[i] & calcxor)
-            return 0;
-         neq |= (maskAndNotModeM[i] & calcxor);
-         }
+bool cSatipSectionFilter::Match(const uint8_t *dataP, int lengthP) const
+{
+  // Short sections are padded for matching the whole filter
+  uint8_t head[eDmxMaxMatchSize];
+  if (lengthP < eDmxMaxMatchSize) {
+     memset(head, 0, sizeof(head));
+     memcpy(head, dataP, lengthP);
+     dataP = head;
+     }
+  // Skip the section length and compare all filter bytes at once
+  cSatipFilterVector data;
+  memcpy(&data, dataP + 2, sizeof(data));
+  data[0] = dataP[0];
+  cSatipFilterVector calcxor = filterValueM ^ data;
+
+  uint64_t words[2];
+  cSatipFilterVector eq = maskAndModeM & calcxor;
+  memcpy(words, &eq, sizeof(words));
+  if (words[0] | words[1])
+     return false;
+
+  if (doneqM) {
+     cSatipFilterVector neq = maskAndNotModeM & calcxor;
+     memcpy(words, &neq, sizeof(words));
+     return (words[0] | words[1]) != 0;
+     }
+  return true;
+}
 
-     if (doneqM && !neq)
+bool cSatipSectionFilter::IsDuplicate(const handleStruct &handleP, const uint8_t *dataP, int lengthP) const
+{
+  unsigned int refresh = SatipConfig.GetSectionRefresh();
+  // Only sections with the long syntax carry a version and a CRC
+  if (!refresh || (lengthP < 12) || !(dataP[1] & 0x80))
+     return false;
+  uint32_t key = ((uint32_t)dataP[0] << 24) | (dataP[3] << 16) | (dataP[4] << 8) | dataP[6];
+  std::unordered_map<uint32_t, deliveredStruct>::const_iterator it = handleP.delivered.find(key);
+  if (it == handleP.delivered.end())
+     return false;
+  uint32_t crc = ((uint32_t)dataP[lengthP - 4] << 24) | (dataP[lengthP - 3] << 16) | (dataP[lengthP - 2] << 8) | dataP[lengthP - 1];
+  uint8_t version = (uint8_t)((dataP[5] >> 1) & 0x1F);
+  return (it->second.crc == crc) && (it->second.version == version) && (cTimeMs::Now() - it->second.timestamp < refresh * 1000ULL);
+}
+
+void cSatipSectionFilter::SetDelivered(handleStruct &handleP, const uint8_t *dataP, int lengthP)
+{
+  if (!SatipConfig.GetSectionRefresh() || (lengthP < 12) || !(dataP[1] & 0x80))
+     return;
+  uint32_t key = ((uint32_t)dataP[0] << 24) | (dataP[3] << 16) | (dataP[4] << 8) | dataP[6];
+  if ((handleP.delivered.size() >= eMaxDeliveredSections) && !handleP.delivered.count(key))
+     handleP.delivered.clear();
+  deliveredStruct &delivered = handleP.delivered[key];
+  delivered.crc = ((uint32_t)dataP[lengthP - 4] << 24) | (dataP[lengthP - 3] << 16) | (dataP[lengthP - 2] << 8) | dataP[lengthP - 1];
+  delivered.version = (uint8_t)((dataP[5] >> 1) & 0x1F);
+  delivered.timestamp = cTimeMs::Now();
+}
+
+int cSatipSectionFilter::Filter(void)
+{
+  if (secBufM && (secLenM > 0)) {
+     bool match = Match(secBufM, secLenM);
+     bool cacheable = cSatipSectionCache::IsCacheable(pidM, secBufM, secLenM);
+     if (!match && !cacheable)
         return 0;
 
-     if (ringBufferM && (secLenM > 0)) {
-        cFrame* section = new cFrame(secBufM, secLenM);
-        if (!ringBufferM->Put(section))
-           DELETE_POINTER(section);
+     // Sections corrupted by packet loss never leave the plugin
+     if (HasCrc(secBufM, secLenM) && crc32_mpeg2(secBufM, secLenM)) {
+        AddCrcErrorStatistic(1);
+        return 0;
         }
+
+     if (cacheable)
+        cSatipSectionCache::GetInstance()->Store(transponderM, pidM, secBufM, secLenM);
+
+     if (!match)
+        return 0;
+
+     Put(secBufM, secLenM);
      }
   return 0;
 }
@@ -132,7 +296,16 @@ int cSatipSectionFilter::CopyDump(const uint8_t *bufP, uint8_t lenP)
   if (lenP == 0)
      return 0;
 
-  memcpy(secBufBaseM + tsFeedpM, bufP, lenP);
+  // Most tables fit into the initial size, the rest grows up to the maximum
+  size_t needed = tsFeedpM + lenP + eDmxMaxMatchSize;
+  if (secBufBaseM.size() < needed) {
+     size_t size = secBufBaseM.empty() ? eDmxMinSectionFeedSize : secBufBaseM.size();
+     while (size < needed)
+           size *= 2;
+     secBufBaseM.resize(min(size, (size_t)(eDmxMaxSectionFeedSize + eDmxMaxMatchSize)));
+     }
+
+  memcpy(&secBufBaseM[tsFeedpM], bufP, lenP);
   tsFeedpM = uint16_t(tsFeedpM + lenP);
 
   limit = tsFeedpM;
@@ -140,7 +313,7 @@ int cSatipSectionFilter::CopyDump(const uint8_t *bufP, uint8_t lenP)
      return -1; // internal error should never happen
 
   // Always set secbuf
-  secBufM = secBufBaseM + secBufpM;
+  secBufM = &secBufBaseM[secBufpM];
 
   for (n = 0; secBufpM + 2 < limit; ++n) {
       uint16_t seclen = GetLength(secBufM);
@@ -212,58 +385,100 @@ void cSatipSectionFilter::Process(const uint8_t* dataP)
      }
 }
 
-void cSatipSectionFilter::Send(void)
+bool cSatipSectionFilter::Queue(const uint8_t *dataP, int lengthP, int fdP)
 {
-  cFrame *section = ringBufferM->Get();
-  if (section) {
-     uchar *data = section->Data();
-     int count = section->Count();
-     if (data && (count > 0) && (socketM[1] >= 0) && (socketM[0] >= 0)) {
-        if (send(socketM[1], data, count, MSG_EOR) > 0) {
+  if ((lengthP <= 0) || !Match(dataP, lengthP))
+     return false;
+  if (fdP < 0)
+     return Put(dataP, lengthP);
+  // Only for a handle joining an existing filter
+  for (std::vector<handleStruct>::iterator it = handlesM.begin(); it != handlesM.end(); ++it) {
+      if (it->socket[0] == fdP) {
+         it->primed.push_back(sectionStruct());
+         it->primed.back().data.assign(dataP, dataP + lengthP);
+         it->primed.back().timestamp = cTimeMs::Now();
+         return true;
+         }
+      }
+  return false;
+}
+
+int cSatipSectionFilter::Send(unsigned int indexP, int *latencyMsP)
+{
+  int sent = 0;
+  bool suppressed = true;
+  // Unchanged repetitions are skipped until a section has been sent
+  while (suppressed && Pending(indexP)) {
+        handleStruct &handle = handlesM[indexP];
+        // The cached sections primed for this handle go first
+        bool primed = !handle.primed.empty();
+        const sectionStruct &section = primed ? handle.primed.front() : sectionsM[handle.cursor - firstSectionM];
+        int count = (int)section.data.size();
+        suppressed = IsDuplicate(handle, &section.data[0], count);
+        if (suppressed)
+           AddSuppressedStatistic(1);
+        else if (send(handle.socket[1], &section.data[0], count, MSG_EOR) > 0) {
            // Update statistics
            AddSectionStatistic(count, 1);
+           if (latencyMsP)
+              *latencyMsP = (int)(cTimeMs::Now() - section.timestamp);
+           SetDelivered(handle, &section.data[0], count);
+           sent = count;
+           }
+        else if (errno == EAGAIN)
+           return -1; // retry once the socket is writable again
+        else
+           error("failed to send section data (%i bytes) [device=%d]", count, deviceIndexM);
+        if (primed)
+           handle.primed.pop_front();
+        else {
+           ++handle.cursor;
+           Trim();
            }
-        else if (errno != EAGAIN)
-          error("failed to send section data (%i bytes) [device=%d]", count, deviceIndexM);
         }
-     ringBufferM->Drop(section);
-     }
+  return sent;
 }
 
 int cSatipSectionFilter::Available(void) const
 {
-  return ringBufferM->Available();
+  for (unsigned int i = 0; i < handlesM.size(); ++i) {
+      if (Pending(i))
+         return 1;
+      }
+  return 0;
 }
 
+const int cSatipSectionFilterHandler::sendBudgetsS[cSatipSectionFilter::scCount] = {
+  KILOBYTE(64), // PSI
+  KILOBYTE(16), // SI
+  KILOBYTE(8)   // EIT
+};
+
 cSatipSectionFilterHandler::cSatipSectionFilterHandler(int deviceIndexP, unsigned int bufferLenP)
 : cThread(cString::sprintf("SATIP#%d section handler", deviceIndexP)),
-  ringBufferM(new cRingBufferLinear(bufferLenP, TS_SIZE, false, *cString::sprintf("SATIP %d section handler", deviceIndexP))),
+  ringBufferM(NULL),
+  bufferLenM(bufferLenP),
+  dataReadyM(),
   mutexM(),
-  deviceIndexM(deviceIndexP)
+  shrinkTimerM(eShrinkIntervalMs),
+  deviceIndexM(deviceIndexP),
+  transponderM(0),
+  pendingTransponderM(0),
+  flushPendingM(false),
+  resyncM(false),
+  loopM(cSatipEventLoop::Get(deviceIndexP))
 {
   dbg_funcname("%s (%d, %d) [device %d]", __PRETTY_FUNCTION__, deviceIndexM, bufferLenP, deviceIndexM);
 
   // Initialize filter pointers
   memset(filtersM, 0, sizeof(filtersM));
-
-  // Create input buffer
-  if (ringBufferM) {
-     ringBufferM->SetTimeouts(100, 100);
-     ringBufferM->SetIoThrottle();
-     }
-  else
-     error("Failed to allocate buffer for section filter handler [device=%d]", deviceIndexM);
-
-  Start();
+  memset(classesM, 0, sizeof(classesM));
 }
 
 cSatipSectionFilterHandler::~cSatipSectionFilterHandler()
 {
   dbg_funcname("%s [device %d]", __PRETTY_FUNCTION__, deviceIndexM);
-  // Stop thread
-  if (Running())
-     Cancel(3);
-  DELETE_POINTER(ringBufferM);
+  Deactivate();
 
   // Destroy all filters
   cMutexLock MutexLock(&mutexM);
@@ -271,37 +486,68 @@ cSatipSectionFilterHandler::~cSatipSectionFilterHandler()
       Delete(i);
 }
 
-void cSatipSectionFilterHandler::SendAll(void)
+int cSatipSectionFilterHandler::SendAll(void)
 {
-  cMutexLock MutexLock(&mutexM);
-  bool pendingData;
-  do {
-     pendingData = false;
-
-     // zero polling structures
-     memset(pollFdsM, 0, sizeof(pollFdsM));
-
-     // assemble all handlers to poll (use -1 to ignore handlers)
-     for (unsigned int i = 0; i < eMaxSecFilterCount; ++i) {
-         if (filtersM[i] && filtersM[i]->Available() != 0) {
-            pollFdsM[i].fd = filtersM[i]->GetFd();
-            pollFdsM[i].events = POLLOUT;
-            pendingData = true;
-            }
-         else
-            pollFdsM[i].fd = -1;
-         }
+  pollFdsM.clear();
+  pollIndexesM.clear();
+
+  // assemble all handles with pending sections to poll, ordered by
+  // the priority of their delivery class
+  mutexM.Lock();
+  for (int c = 0; c < cSatipSectionFilter::scCount; ++c) {
+      for (unsigned int i = 0; i < eMaxSecFilterCount; ++i) {
+          if (filtersM[i] && (filtersM[i]->Class() == c)) {
+             for (int j = 0; j < filtersM[i]->Handles(); ++j) {
+                 if (filtersM[i]->Pending(j)) {
+                    struct pollfd pfd;
+                    pfd.fd = filtersM[i]->GetFd(j);
+                    pfd.events = POLLOUT;
+                    pfd.revents = 0;
+                    pollFdsM.push_back(pfd);
+                    pollIndexesM.push_back(std::make_pair(i, (unsigned int)j));
+                    }
+                 }
+             }
+          }
+      }
+  mutexM.Unlock();
 
-     // exit if there isn't any pending data or we time out
-     if (!pendingData || poll(pollFdsM, eMaxSecFilterCount, eSecFilterSendTimeoutMs) <= 0)
-        return;
+  // exit if there isn't any pending data or we time out, the filters may
+  // be opened and closed meanwhile
+  if (pollFdsM.empty())
+     return 0;
+  // don't block the other devices running on the same event loop
+  if (poll(&pollFdsM[0], pollFdsM.size(), loopM ? 0 : eSecFilterSendTimeoutMs) <= 0)
+     return -1;
 
-     // send data (if available)
-     for (unsigned int i = 0; i < eMaxSecFilterCount && pendingData; ++i) {
-         if (pollFdsM[i].revents & POLLOUT)
-            filtersM[i]->Send();
+  // send a single round of data up to the byte budget of each handle, so
+  // that new TS packets are processed in between
+  bool pendingData = false;
+  cMutexLock MutexLock(&mutexM);
+  for (unsigned int i = 0; i < pollFdsM.size(); ++i) {
+      cSatipSectionFilter *filter = filtersM[pollIndexesM[i].first];
+      unsigned int index = pollIndexesM[i].second;
+      if (!filter || (filter->GetFd(index) != pollFdsM[i].fd))
+         continue;
+      if (pollFdsM[i].revents & POLLOUT) {
+         classStruct &cls = classesM[filter->Class()];
+         int budget = sendBudgetsS[filter->Class()];
+         while (budget > 0) {
+               int latency = 0;
+               int sent = filter->Send(index, &latency);
+               if (sent <= 0)
+                  break;
+               budget -= sent;
+               ++cls.sections;
+               cls.latencyTotalMs += latency;
+               if (latency > cls.latencyMaxMs)
+                  cls.latencyMaxMs = latency;
+               }
          }
-  } while (pendingData);
+      if (filter->Pending(index))
+         pendingData = true;
+      }
+  return pendingData ? 1 : 0;
 }
 
 void cSatipSectionFilterHandler::Action(void)
@@ -309,51 +555,147 @@ void cSatipSectionFilterHandler::Action(void)
   dbg_funcname("%s Entering [device %d]", __PRETTY_FUNCTION__, deviceIndexM);
   // Do the thread loop
   while (Running()) {
-        uchar *p = NULL;
-        int len = 0;
-        // Process all pending TS packets
-        while ((p  = ringBufferM->Get(len)) != NULL) {
-              if (p && (len >= TS_SIZE)) {
-                 if (*p != TS_SYNC_BYTE) {
-                    for (int i = 1; i < len; ++i) {
-                        if (p[i] == TS_SYNC_BYTE) {
-                           len = i;
-                           break;
-                           }
-                        }
-                    ringBufferM->Del(len);
-                    dbg_funcname("%s Skipped %d bytes to sync on TS packet [device %d]", __PRETTY_FUNCTION__, len, deviceIndexM);
-                    continue;
-                    }
-                    // Process TS packet through all filters
-                    mutexM.Lock();
-                    for (unsigned int i = 0; i < eMaxSecFilterCount; ++i) {
-                        if (filtersM[i])
-                           filtersM[i]->Process(p);
-                        }
-                    mutexM.Unlock();
-                    ringBufferM->Del(TS_SIZE);
-                    }
-                }
-
-        // Send demuxed section packets through all filters
-        SendAll();
+        // Sleep until Write() has put at least a datagram
+        int timeout = RunOnce();
+        if (timeout > 0)
+           dataReadyM.Wait(timeout);
         }
   dbg_funcname("%s Exiting [device %d]", __PRETTY_FUNCTION__, deviceIndexM);
 }
 
+int cSatipSectionFilterHandler::RunOnce(void)
+{
+  uchar *p = NULL;
+  int len = 0;
+  // Drop the packets of the previous transponder before switching the cache
+  if (flushPendingM.exchange(false)) {
+     ringBufferM->Clear();
+     resyncM = false;
+     cMutexLock MutexLock(&mutexM);
+     ApplyTransponder(pendingTransponderM);
+     }
+  // Process all pending TS packets
+  while ((p  = ringBufferM->Get(len)) != NULL) {
+        if (p && (len >= TS_SIZE)) {
+           if ((*p != TS_SYNC_BYTE) || resyncM) {
+              bool confirmed;
+              int skip = ts_sync_find(p, len, &confirmed);
+              // the confirming packets of a candidate may wrap around the end
+              // of the ring, where they can't be checked
+              if (!confirmed && (skip < len) && (ringBufferM->Available() >= skip + 3 * TS_SIZE))
+                 ++skip;
+              if (skip > 0) {
+                 ringBufferM->Del(skip);
+                 dbg_funcname("%s Skipped %d bytes to sync on TS packet [device %d]", __PRETTY_FUNCTION__, skip, deviceIndexM);
+                 }
+              // wait for the packets confirming the sync byte
+              resyncM = !confirmed;
+              if (resyncM && (ringBufferM->Available() < 3 * TS_SIZE))
+                 break;
+              continue;
+              }
+              // Process TS packet through all filters
+              mutexM.Lock();
+              for (unsigned int i = 0; i < eMaxSecFilterCount; ++i) {
+                  if (filtersM[i])
+                     filtersM[i]->Process(p);
+                  }
+              mutexM.Unlock();
+              ringBufferM->Del(TS_SIZE);
+              }
+          }
+
+  // Send demuxed section packets through all filters
+  int sending = SendAll();
+
+  if (shrinkTimerM.TimedOut()) {
+     mutexM.Lock();
+     for (unsigned int i = 0; i < eMaxSecFilterCount; ++i) {
+         if (filtersM[i])
+            filtersM[i]->Shrink();
+         }
+     mutexM.Unlock();
+     shrinkTimerM.Set(eShrinkIntervalMs);
+     }
+
+  if ((sending > 0) || (!resyncM && (ringBufferM->Available() >= TS_SIZE)))
+     return 0;
+  // Retry the blocked handles later, the thread has waited in poll() already
+  if (sending < 0)
+     return loopM ? eSecFilterSendTimeoutMs : 0;
+  return eDataWaitMs;
+}
+
+bool cSatipSectionFilterHandler::Activate(void)
+{
+  if (ringBufferM)
+     return true;
+  dbg_funcname("%s [device %d]", __PRETTY_FUNCTION__, deviceIndexM);
+  // Create input buffer
+  ringBufferM = new cRingBufferLinear(bufferLenM, TS_SIZE, false, *cString::sprintf("SATIP %d section handler", deviceIndexM));
+  if (!ringBufferM) {
+     error("Failed to allocate buffer for section filter handler [device=%d]", deviceIndexM);
+     return false;
+     }
+  ringBufferM->SetTimeouts(100, 0);
+  ringBufferM->SetIoThrottle();
+  resyncM = false;
+
+  if (loopM)
+     loopM->Attach(this);
+  else
+     Start();
+  return true;
+}
+
+void cSatipSectionFilterHandler::Deactivate(void)
+{
+  if (!ringBufferM)
+     return;
+  dbg_funcname("%s [device %d]", __PRETTY_FUNCTION__, deviceIndexM);
+  // Stop thread, the filters and their handles stay open
+  if (loopM)
+     loopM->Detach(this);
+  if (Running()) {
+     Cancel(-1);
+     dataReadyM.Signal();
+     Cancel(3);
+     }
+  DELETE_POINTER(ringBufferM);
+}
+
+cString cSatipSectionFilterHandler::ToString(void) const
+{
+  return cString::sprintf("Section handler [device %d]", deviceIndexM);
+}
+
 cString cSatipSectionFilterHandler::GetInformation(void)
 {
   dbg_funcname_ext("%s [device %d]", __PRETTY_FUNCTION__, deviceIndexM);
   // loop through active section filters
   cMutexLock MutexLock(&mutexM);
   cString s = "";
+  static const char *classNames[cSatipSectionFilter::scCount] = { "PSI", "SI", "EIT" };
+  int queued[cSatipSectionFilter::scCount] = { 0 };
+  for (unsigned int i = 0; i < eMaxSecFilterCount; ++i) {
+      if (filtersM[i]) {
+         for (int j = 0; j < filtersM[i]->Handles(); ++j)
+             queued[filtersM[i]->Class()] += filtersM[i]->Queued(j);
+         }
+      }
+  for (int c = 0; c < cSatipSectionFilter::scCount; ++c) {
+      classStruct &cls = classesM[c];
+      s = cString::sprintf("%sDelivery %s: %d queued, %ld sent, latency %ld/%ld ms (avg/max)\n", *s, classNames[c],
+                           queued[c], cls.sections, cls.sections ? cls.latencyTotalMs / cls.sections : 0L, cls.latencyMaxMs);
+      cls.sections = cls.latencyTotalMs = cls.latencyMaxMs = 0;
+      }
   unsigned int count = 0;
   for (unsigned int i = 0; i < eMaxSecFilterCount; ++i) {
       if (filtersM[i]) {
-         s = cString::sprintf("%sFilter %d: %s Pid=0x%02X (%s)\n", *s, i,
+         s = cString::sprintf("%sFilter %d: %s Pid=0x%02X (%s) Handles=%d Peak=%d/%ldB\n", *s, i,
                               *filtersM[i]->GetSectionStatistic(), filtersM[i]->GetPid(),
-                              id_pid(filtersM[i]->GetPid()));
+                              id_pid(filtersM[i]->GetPid()), filtersM[i]->Handles(),
+                              filtersM[i]->GetHighWaterSections(), filtersM[i]->GetHighWaterMark());
          if (++count > SATIP_STATS_ACTIVE_FILTERS_COUNT)
             break;
          }
@@ -406,16 +748,39 @@ bool cSatipSectionFilterHandler::IsBlackListed(u_short pidP, u_char tidP, u_char
 
 int cSatipSectionFilterHandler::Open(u_short pidP, u_char tidP, u_char maskP)
 {
+  // VDR filters on the table id only, the other filter bytes match anything
+  u_char value[cSatipSectionFilter::eDmxMaxFilterSize] = { tidP };
+  u_char mask[cSatipSectionFilter::eDmxMaxFilterSize] = { maskP };
+  u_char mode[cSatipSectionFilter::eDmxMaxFilterSize] = { 0 };
   cMutexLock MutexLock(&mutexM);
   // Blacklist check, refuse certain filters
   if (IsBlackListed(pidP, tidP, maskP))
      return -1;
+  // Identical filters share the reassembly and the filtered sections
+  for (unsigned int i = 0; i < eMaxSecFilterCount; ++i) {
+      if (filtersM[i] && filtersM[i]->Equals(pidP, value, mask, mode)) {
+         int handle = filtersM[i]->AddHandle();
+         // The other handles have got the cached tables already
+         if (handle >= 0)
+            cSatipSectionCache::GetInstance()->Prime(transponderM, filtersM[i], handle);
+         dbg_funcname_ext("%s (%d, %02X, %02X) handle=%d index=%u shared [device %d]", __PRETTY_FUNCTION__, pidP, tidP, maskP, handle, i, deviceIndexM);
+         return handle;
+         }
+      }
   // Search the next free filter slot
   for (unsigned int i = 0; i < eMaxSecFilterCount; ++i) {
       if (!filtersM[i]) {
-         filtersM[i] = new cSatipSectionFilter(deviceIndexM, pidP, tidP, maskP);
-         dbg_funcname_ext("%s (%d, %02X, %02X) handle=%d index=%u [device %d]", __PRETTY_FUNCTION__, pidP, tidP, maskP, filtersM[i]->GetFd(), i, deviceIndexM);
-         return filtersM[i]->GetFd();
+         filtersM[i] = new cSatipSectionFilter(deviceIndexM, pidP, value, mask, mode);
+         int handle = filtersM[i]->AddHandle();
+         if (handle < 0) {
+            Delete(i);
+            return -1;
+            }
+         filtersM[i]->SetTransponder(transponderM);
+         // Deliver the cached tables at once instead of waiting for their repetition
+         cSatipSectionCache::GetInstance()->Prime(transponderM, filtersM[i]);
+         dbg_funcname_ext("%s (%d, %02X, %02X) handle=%d index=%u [device %d]", __PRETTY_FUNCTION__, pidP, tidP, maskP, handle, i, deviceIndexM);
+         return handle;
          }
       }
   // No free filter slot found
@@ -427,9 +792,11 @@ void cSatipSectionFilterHandler::Close(int handleP)
   cMutexLock MutexLock(&mutexM);
   // Search the filter for deletion
   for (unsigned int i = 0; i < eMaxSecFilterCount; ++i) {
-      if (filtersM[i] && (handleP == filtersM[i]->GetFd())) {
+      if (filtersM[i] && filtersM[i]->HasHandle(handleP)) {
          dbg_sectionfilter("%s (%d) pid=%d index=%u [device %d]", __PRETTY_FUNCTION__, handleP, filtersM[i]->GetPid(), i, deviceIndexM);
-         Delete(i);
+         filtersM[i]->RemoveHandle(handleP);
+         if (!filtersM[i]->Handles())
+            Delete(i);
          break;
          }
       }
@@ -440,7 +807,7 @@ int cSatipSectionFilterHandler::GetPid(int handleP)
   cMutexLock MutexLock(&mutexM);
   // Search the filter for data
   for (unsigned int i = 0; i < eMaxSecFilterCount; ++i) {
-      if (filtersM[i] && (handleP == filtersM[i]->GetFd())) {
+      if (filtersM[i] && filtersM[i]->HasHandle(handleP)) {
          dbg_sectionfilter("%s (%d) pid=%d index=%u [device %d]", __PRETTY_FUNCTION__, handleP, filtersM[i]->GetPid(), i, deviceIndexM);
          return filtersM[i]->GetPid();
          }
@@ -448,13 +815,71 @@ int cSatipSectionFilterHandler::GetPid(int handleP)
   return -1;
 }
 
+std::vector<int> cSatipSectionFilterHandler::GetPids(void)
+{
+  cMutexLock MutexLock(&mutexM);
+  std::vector<int> pids;
+  for (unsigned int i = 0; i < eMaxSecFilterCount; ++i) {
+      if (filtersM[i] && (std::find(pids.begin(), pids.end(), filtersM[i]->GetPid()) == pids.end()))
+         pids.push_back(filtersM[i]->GetPid());
+      }
+  return pids;
+}
+
+void cSatipSectionFilterHandler::SetTransponder(int sourceP, int transponderP)
+{
+  dbg_funcname_ext("%s (%d, %d) [device %d]", __PRETTY_FUNCTION__, sourceP, transponderP, deviceIndexM);
+  uint64_t transponder = cSatipSectionCache::Key(sourceP, transponderP);
+  cMutexLock MutexLock(&mutexM);
+  // Nothing is cached while the transponder is unknown, e.g. during a zap
+  if (!transponder || !ringBufferM) {
+     flushPendingM = false;
+     pendingTransponderM = transponder;
+     ApplyTransponder(transponder);
+     return;
+     }
+  if ((transponder == transponderM) || (flushPendingM && (transponder == pendingTransponderM)))
+     return;
+  pendingTransponderM = transponder;
+  flushPendingM = true;
+  Wakeup();
+}
+
+void cSatipSectionFilterHandler::ApplyTransponder(uint64_t transponderP)
+{
+  if (transponderP == transponderM)
+     return;
+  dbg_funcname_ext("%s (%" PRIu64 ") [device %d]", __PRETTY_FUNCTION__, transponderP, deviceIndexM);
+  transponderM = transponderP;
+  if (transponderM)
+     cSatipSectionCache::GetInstance()->Tuned(transponderM);
+  for (unsigned int i = 0; i < eMaxSecFilterCount; ++i) {
+      if (filtersM[i]) {
+         filtersM[i]->SetTransponder(transponderM);
+         cSatipSectionCache::GetInstance()->Prime(transponderM, filtersM[i]);
+         }
+      }
+}
+
+void cSatipSectionFilterHandler::Wakeup(void)
+{
+  if (loopM)
+     loopM->Wakeup(this);
+  else
+     dataReadyM.Signal();
+}
+
 void cSatipSectionFilterHandler::Write(uchar *bufferP, int lengthP)
 {
   dbg_funcname_ext("%s (, %d) [device %d]", __PRETTY_FUNCTION__, lengthP, deviceIndexM);
   // Fill up the buffer
   if (ringBufferM) {
+     // Wake up the handler also for a lone PAT/PMT packet in a drained ring
+     bool drained = ringBufferM->Available() < TS_SIZE;
      int len = ringBufferM->Put(bufferP, lengthP);
      if (len != lengthP)
         ringBufferM->ReportOverflow(lengthP - len);
+     if (drained || (ringBufferM->Available() >= eDataWakeupSize))
+        Wakeup();
      }
 }
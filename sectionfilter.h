@@ -9,18 +9,65 @@
 #define __SATIP_SECTIONFILTER_H
 
 #include <poll.h>
+#include <atomic>
+#include <deque>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <vdr/device.h>
 
 #include "common.h"
+#include "eventloopif.h"
 #include "statistics.h"
 
+/* forward declarations */
+class cSatipEventLoop;
+
+// The filter bytes in the layout of the Linux DVB API: the table id
+// followed by the section bytes after the section length.
+typedef uint8_t cSatipFilterVector __attribute__((vector_size(16)));
+
 class cSatipSectionFilter : public cSatipSectionStatistics {
+public:
+  enum {
+    eDmxMaxFilterSize      = 16
+  };
+  // delivery classes in the order of their priority
+  enum eSectionClass {
+    scPsi,
+    scSi,
+    scEit,
+    scCount
+  };
+
 private:
   enum {
-    eDmxMaxFilterSize      = 18,
+    eDmxMaxMatchSize       = (eDmxMaxFilterSize + 2),
     eDmxMaxSectionCount    = 64,
     eDmxMaxSectionSize     = 4096,
-    eDmxMaxSectionFeedSize = (eDmxMaxSectionSize + TS_SIZE)
+    eDmxMaxSectionFeedSize = (eDmxMaxSectionSize + TS_SIZE),
+    eDmxMinSectionFeedSize = 512,
+    eDmxMaxStoredBytes     = (eDmxMaxSectionCount * eDmxMaxSectionSize),
+    eIdleShrinkTimeoutMs   = 30000, // in milliseconds
+    eMaxDeliveredSections  = 4096
+  };
+  struct deliveredStruct {
+    uint32_t crc;
+    uint8_t version;
+    uint64_t timestamp;
+  };
+  struct sectionStruct {
+    std::vector<uint8_t> data;
+    uint64_t timestamp;
+  };
+  // a file descriptor pair given to VDR, its next section to deliver, the
+  // cached sections primed for it alone and its recently delivered sections
+  // by table id, extension and section number
+  struct handleStruct {
+    int socket[2];
+    uint64_t cursor;
+    std::deque<sectionStruct> primed;
+    std::unordered_map<uint32_t, deliveredStruct> delivered;
   };
 
   int pusiSeenM;
@@ -28,55 +75,109 @@ private:
   int doneqM;
 
   uint8_t *secBufM;
-  uint8_t secBufBaseM[eDmxMaxSectionFeedSize];
+  // grown on demand and padded for matching a short section at the end
+  std::vector<uint8_t> secBufBaseM;
   uint16_t secBufpM;
   uint16_t secLenM;
   uint16_t tsFeedpM;
   uint16_t pidM;
-
-  cRingBufferFrame *ringBufferM;
+  eSectionClass classM;
+  uint64_t transponderM;
+
+  // the filtered sections shared by all handles of identical filters
+  std::deque<sectionStruct> sectionsM;
+  uint64_t firstSectionM;
+  long storedBytesM;
+  long storedBytesHighM;
+  int storedSectionsHighM;
+  bool grownM;
+  uint64_t lastPutM;
   int deviceIndexM;
-  int socketM[2];
-
-  uint8_t filterValueM[eDmxMaxFilterSize];
-  uint8_t filterMaskM[eDmxMaxFilterSize];
-  uint8_t filterModeM[eDmxMaxFilterSize];
+  std::vector<handleStruct> handlesM;
 
-  uint8_t maskAndModeM[eDmxMaxFilterSize];
-  uint8_t maskAndNotModeM[eDmxMaxFilterSize];
+  cSatipFilterVector filterValueM;
+  cSatipFilterVector maskAndModeM;
+  cSatipFilterVector maskAndNotModeM;
 
   inline uint16_t GetLength(const uint8_t *dataP);
+  inline bool HasCrc(const uint8_t *dataP, int lengthP);
+  bool Match(const uint8_t *dataP, int lengthP) const;
+  bool IsDuplicate(const handleStruct &handleP, const uint8_t *dataP, int lengthP) const;
+  void SetDelivered(handleStruct &handleP, const uint8_t *dataP, int lengthP);
   void New(void);
   int Filter(void);
   inline int Feed(void);
   int CopyDump(const uint8_t *bufP, uint8_t lenP);
+  bool Put(const uint8_t *dataP, int lengthP);
+  void Trim(void);
 
 public:
   // constructor & destructor
-  cSatipSectionFilter(int deviceIndexP, uint16_t pidP, uint8_t tidP, uint8_t maskP);
+  cSatipSectionFilter(int deviceIndexP, uint16_t pidP, const uint8_t *valueP, const uint8_t *maskP, const uint8_t *modeP);
   virtual ~cSatipSectionFilter();
   void Process(const uint8_t* dataP);
-  void Send(void);
-  int GetFd(void) { return socketM[0]; }
+  bool Queue(const uint8_t *dataP, int lengthP, int fdP = -1);
+  bool Equals(uint16_t pidP, const uint8_t *valueP, const uint8_t *maskP, const uint8_t *modeP) const;
+  int AddHandle(void);
+  bool RemoveHandle(int fdP);
+  bool HasHandle(int fdP) const;
+  int Handles(void) const { return (int)handlesM.size(); }
+  int GetFd(unsigned int indexP) const { return (indexP < handlesM.size()) ? handlesM[indexP].socket[0] : -1; }
+  bool Pending(unsigned int indexP) const { return (indexP < handlesM.size()) && (!handlesM[indexP].primed.empty() || (handlesM[indexP].cursor < firstSectionM + sectionsM.size())); }
+  int Queued(unsigned int indexP) const { return Pending(indexP) ? (int)(handlesM[indexP].primed.size() + firstSectionM + sectionsM.size() - handlesM[indexP].cursor) : 0; }
+  int Send(unsigned int indexP, int *latencyMsP = NULL);
+  eSectionClass Class(void) const { return classM; }
   uint16_t GetPid(void) const { return pidM; }
+  void SetTransponder(uint64_t transponderP) { transponderM = transponderP; }
+  long GetHighWaterMark(void) const { return storedBytesHighM; }
+  int GetHighWaterSections(void) const { return storedSectionsHighM; }
+  void Shrink(void);
   int Available(void) const;
 };
 
-class cSatipSectionFilterHandler : public cThread {
+class cSatipSectionFilterHandler : public cThread, public cSatipEventLoopIf {
 private:
   enum {
     eMaxSecFilterCount = 32,
-    eSecFilterSendTimeoutMs = 10
+    eSecFilterSendTimeoutMs = 10,
+    eShrinkIntervalMs = 10000,
+    eDataWaitMs = 100,
+    eDataWakeupSize = 7 * TS_SIZE
   };
+  struct classStruct {
+    long sections;
+    long latencyTotalMs;
+    long latencyMaxMs;
+  };
+  // bytes sent per handle and round for each delivery class
+  static const int sendBudgetsS[cSatipSectionFilter::scCount];
+  classStruct classesM[cSatipSectionFilter::scCount];
+  // allocated only while the device is in use
   cRingBufferLinear *ringBufferM;
+  unsigned int bufferLenM;
+  // woken by Write(), the ring buffer itself doesn't wait for data
+  cCondWait dataReadyM;
   cMutex mutexM;
+  cTimeMs shrinkTimerM;
   int deviceIndexM;
+  uint64_t transponderM;
+  // applied by the handler thread once the packets in the ring are dropped
+  uint64_t pendingTransponderM;
+  std::atomic<bool> flushPendingM;
+  // the ring starts at an unconfirmed sync byte
+  bool resyncM;
+  cSatipEventLoop *loopM;
   cSatipSectionFilter *filtersM[eMaxSecFilterCount];
-  struct pollfd pollFdsM[eMaxSecFilterCount];
+  std::vector<struct pollfd> pollFdsM;
+  // the filter and handle index of each polled descriptor
+  std::vector<std::pair<unsigned int, unsigned int> > pollIndexesM;
 
   bool Delete(unsigned int indexP);
   bool IsBlackListed(u_short pidP, u_char tidP, u_char maskP) const;
-  void SendAll(void);
+  void ApplyTransponder(uint64_t transponderP);
+  void Wakeup(void);
+  // returns 1 while sections are pending, -1 if no handle was writable
+  int SendAll(void);
 
 protected:
   virtual void Action(void);
@@ -89,7 +190,16 @@ public:
   int Open(u_short pidP, u_char tidP, u_char maskP);
   void Close(int handleP);
   int GetPid(int handleP);
+  void SetTransponder(int sourceP, int transponderP);
   void Write(u_char *bufferP, int lengthP);
+  std::vector<int> GetPids(void);
+  bool Activate(void);
+  void Deactivate(void);
+
+  // for internal event loop interface
+public:
+  virtual int RunOnce(void);
+  virtual cString ToString(void) const;
 };
 
 #endif // __SATIP_SECTIONFILTER_H
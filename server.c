@@ -5,6 +5,8 @@
  *
  */
 
+#include <algorithm>
+
 #include <vdr/sources.h>
 
 #include "config.h"
@@ -28,6 +30,20 @@ cSatipFrontend::~cSatipFrontend()
 
 // --- cSatipFrontends --------------------------------------------------------
 
+void cSatipFrontends::Index(cSatipFrontend *frontendP)
+{
+  ++usedM;
+  ++transpondersM[frontendP->Transponder()];
+}
+
+void cSatipFrontends::Unindex(cSatipFrontend *frontendP)
+{
+  std::map<int, int>::iterator it = transpondersM.find(frontendP->Transponder());
+  if (it != transpondersM.end() && --it->second <= 0)
+     transpondersM.erase(it);
+  --usedM;
+}
+
 bool cSatipFrontends::Matches(int deviceIdP, int transponderP)
 {
   for (cSatipFrontend *f = First(); f; f = Next(f)) {
@@ -48,7 +64,14 @@ bool cSatipFrontends::Assign(int deviceIdP, int transponderP)
          }
       }
   if (tmp) {
-     tmp->SetTransponder(transponderP);
+     // Keep the transponder index in sync for an attached frontend
+     if (tmp->Attached()) {
+        Unindex(tmp);
+        tmp->SetTransponder(transponderP);
+        Index(tmp);
+        }
+     else
+        tmp->SetTransponder(transponderP);
      return true;
      }
   return false;
@@ -58,6 +81,8 @@ bool cSatipFrontends::Attach(int deviceIdP, int transponderP)
 {
   for (cSatipFrontend *f = First(); f; f = Next(f)) {
       if (f->Transponder() == transponderP) {
+         if (!f->Attached())
+            Index(f);
          f->Attach(deviceIdP);
          dbg_chan_switch("%s (%d, %d) %s/#%d", __PRETTY_FUNCTION__, deviceIdP, transponderP, *f->Description(), f->Index());
          return true;
@@ -70,7 +95,10 @@ bool cSatipFrontends::Detach(int deviceIdP, int transponderP)
 {
   for (cSatipFrontend *f = First(); f; f = Next(f)) {
       if (f->Transponder() == transponderP) {
+         bool attached = f->Attached();
          f->Detach(deviceIdP);
+         if (attached && !f->Attached())
+            Unindex(f);
          dbg_chan_switch("%s (%d, %d) %s/#%d", __PRETTY_FUNCTION__, deviceIdP, transponderP, *f->Description(), f->Index());
          return true;
          }
@@ -91,8 +119,16 @@ cSatipServer::cSatipServer(const char *srcAddressP, const char *addressP, const
   quirkM(quirkP),
   hasCiM(false),
   activeM(true),
+  departedM(false),
+  provisionalM(false),
+  describesM(0),
+  describesAvoidedM(0),
   createdM(time(NULL)),
-  lastSeenM(0)
+  lastSeenM(0),
+  cachedSeenM(0),
+  trafficBytesM(0),
+  bitrateM(0),
+  trafficM(0)
 {
   memset(sourceFiltersM, 0, sizeof(sourceFiltersM));
   if (!isempty(*filtersM)) {
@@ -176,6 +212,8 @@ cSatipServer::cSatipServer(const char *srcAddressP, const char *addressP, const
      quirksM = cString::sprintf("%s%sCiTnr", *quirksM, isempty(*quirksM) ? "" : ",");
   if ((quirkM & eSatipQuirkMask) & eSatipQuirkForcePilot)
      quirksM = cString::sprintf("%s%sForcePilot", *quirksM, isempty(*quirksM) ? "" : ",");
+  if ((quirkM & eSatipQuirkMask) & eSatipQuirkFullMux)
+     quirksM = cString::sprintf("%s%sFullMux", *quirksM, isempty(*quirksM) ? "" : ",");
   dbg_parsing("%s description=%s quirks=%s", __PRETTY_FUNCTION__, *descriptionM, *quirksM);
   // These devices support external CI
   if (strstr(*descriptionM, "OctopusNet") ||            // Digital Devices OctopusNet
@@ -252,6 +290,76 @@ bool cSatipServer::IsValidSource(int sourceP)
   return true;
 }
 
+int cSatipServer::DelSystems(int sourceP, int systemP, int *delsysP)
+{
+  int n = 0;
+  switch ((char)(sourceP >> 24)) {
+    case 'S':
+         delsysP[n++] = delsysDVBS2;
+         break;
+    case 'T':
+         if (!systemP)
+            delsysP[n++] = delsysDVBT;
+         delsysP[n++] = delsysDVBT2;
+         break;
+    case 'C':
+         if (!systemP)
+            delsysP[n++] = delsysDVBC;
+         delsysP[n++] = delsysDVBC2;
+         break;
+    case 'A':
+         delsysP[n++] = delsysATSC;
+         break;
+    default:
+         break;
+    }
+  return n;
+}
+
+bool cSatipServer::HasTransponder(int sourceP, int systemP, int transponderP)
+{
+  int delsys[delsysCount];
+  int n = DelSystems(sourceP, systemP, delsys);
+  for (int i = 0; i < n; ++i) {
+      if (frontendsM[delsys[i]].HasTransponder(transponderP))
+         return true;
+      }
+  return false;
+}
+
+int cSatipServer::GetLoad(int sourceP, int systemP, int &totalP)
+{
+  int delsys[delsysCount];
+  int n = DelSystems(sourceP, systemP, delsys);
+  int used = 0;
+  totalP = 0;
+  if (IsValidSource(sourceP)) {
+     for (int i = 0; i < n; ++i) {
+         used += frontendsM[delsys[i]].Used();
+         totalP += frontendsM[delsys[i]].Count();
+         }
+     }
+  return used;
+}
+
+void cSatipServer::AddTraffic(long bytesP)
+{
+  uint64_t elapsed = trafficM.Elapsed();
+  trafficBytesM += bytesP;
+  if (elapsed >= eTrafficWindowMs) {
+     // bytes per millisecond times eight equals kbit/s
+     bitrateM = (elapsed > 2 * eTrafficWindowMs) ? (long)(trafficBytesM * 8 / elapsed) : (bitrateM + (long)(trafficBytesM * 8 / elapsed)) / 2;
+     trafficBytesM = 0;
+     trafficM.Set();
+     }
+}
+
+long cSatipServer::Bitrate(void)
+{
+  // Stale measurements mean that nothing is streamed anymore
+  return (trafficM.Elapsed() > 2 * eTrafficWindowMs) ? 0 : bitrateM;
+}
+
 bool cSatipServer::Assign(int DeviceId, int Source, int DelSys, int Transponder) {
   if (not IsValidSource(Source))
      return false;
@@ -367,6 +475,54 @@ int cSatipServer::GetModulesATSC(void)
   return frontendsM[delsysATSC].Count();
 }
 
+// --- cSatipServerPolicy -----------------------------------------------------
+
+const cSatipServerPolicy &cSatipServerPolicy::Get(void)
+{
+  static const cSatipFirstServerPolicy first;
+  static const cSatipLoadServerPolicy load;
+  if (SatipConfig.GetAssignPolicy() == cSatipConfig::eAssignPolicyFirst)
+     return first;
+  return load;
+}
+
+void cSatipLoadServerPolicy::Order(std::vector<cSatipServer *> &serversP, int sourceP, int systemP, int transponderP) const
+{
+  struct tLoad {
+    cSatipServer *server;
+    bool tuned;
+    int used;
+    int total;
+    long bitrate;
+  };
+  if (serversP.size() < 2)
+     return;
+  std::vector<tLoad> loads;
+  loads.reserve(serversP.size());
+  for (auto s : serversP) {
+      tLoad l;
+      l.server = s;
+      l.tuned = s->HasTransponder(sourceP, systemP, transponderP);
+      l.used = s->GetLoad(sourceP, systemP, l.total);
+      l.bitrate = s->Bitrate();
+      loads.push_back(l);
+      }
+  std::stable_sort(loads.begin(), loads.end(), [](const tLoad &a, const tLoad &b) {
+    if (a.tuned != b.tuned)
+       return a.tuned;
+    // servers without any suitable frontend go last
+    if (!a.total || !b.total)
+       return a.total > b.total;
+    // compare the used fractions without dividing
+    long la = (long)a.used * b.total, lb = (long)b.used * a.total;
+    if (la != lb)
+       return la < lb;
+    return a.bitrate < b.bitrate;
+  });
+  for (size_t i = 0; i < loads.size(); ++i)
+      serversP[i] = loads[i].server;
+}
+
 // --- cSatipServers ----------------------------------------------------------
 
 cSatipServer *cSatipServers::Find(cSatipServer *serverP)
@@ -387,24 +543,57 @@ cSatipServer *cSatipServers::Find(int sourceP)
   return NULL;
 }
 
-cSatipServer *cSatipServers::Assign(int deviceIdP, int sourceP, int transponderP, int systemP)
+int cSatipServers::Candidates(int sourceP, std::vector<cSatipServer *> &serversP)
 {
+  serversP.clear();
   for (cSatipServer *s = First(); s; s = Next(s)) {
+      if (s->Matches(sourceP))
+         serversP.push_back(s);
+      }
+  return stateM;
+}
+
+cSatipServer *cSatipServers::Assign(std::vector<cSatipServer *> &serversP, int deviceIdP, int sourceP, int transponderP, int systemP)
+{
+  for (auto s : serversP) {
       if (s->IsActive() && s->Matches(deviceIdP, sourceP, systemP, transponderP))
          return s;
       }
-  for (cSatipServer *s = First(); s; s = Next(s)) {
+  cSatipServerPolicy::Get().Order(serversP, sourceP, systemP, transponderP);
+  for (auto s : serversP) {
       if (s->IsActive() && s->Assign(deviceIdP, sourceP, systemP, transponderP))
          return s;
       }
   return NULL;
 }
 
+cSatipServer *cSatipServers::Assign(int deviceIdP, int sourceP, int transponderP, int systemP, const std::vector<cSatipServer *> &candidatesP)
+{
+  // The candidates are only valid as long as the server list is unchanged
+  std::vector<cSatipServer *> servers(candidatesP);
+  return Assign(servers, deviceIdP, sourceP, transponderP, systemP);
+}
+
+cSatipServer *cSatipServers::Assign(int deviceIdP, int sourceP, int transponderP, int systemP)
+{
+  std::vector<cSatipServer *> servers;
+  for (cSatipServer *s = First(); s; s = Next(s))
+      servers.push_back(s);
+  return Assign(servers, deviceIdP, sourceP, transponderP, systemP);
+}
+
 cSatipServer *cSatipServers::Update(cSatipServer *serverP)
 {
   for (cSatipServer *s = First(); s; s = Next(s)) {
       if (s->Compare(*serverP) == 0) {
          s->Update();
+         // a server announcing itself again after a byebye is fetched anew
+         if (s->IsDeparted()) {
+            info("Reactivating server %s (%s %s)", s->Description(), s->Address(), s->Model());
+            s->Depart(false);
+            s->Activate(true);
+            ++stateM;
+            }
          return s;
          }
       }
@@ -416,6 +605,8 @@ void cSatipServers::Activate(cSatipServer *serverP, bool onOffP)
   for (cSatipServer *s = First(); s; s = Next(s)) {
       if (s == serverP) {
          s->Activate(onOffP);
+         s->Depart(false);
+         ++stateM;
          break;
          }
       }
@@ -465,14 +656,71 @@ bool cSatipServers::HasCI(cSatipServer *serverP)
   return result;
 }
 
-void cSatipServers::Cleanup(uint64_t intervalMsP)
+void cSatipServers::CountDescribe(cSatipServer *serverP, bool avoidedP)
+{
+  for (cSatipServer *s = First(); s; s = Next(s)) {
+      if (s == serverP) {
+         s->CountDescribe(avoidedP);
+         break;
+         }
+      }
+}
+
+void cSatipServers::AddTraffic(cSatipServer *serverP, long bytesP)
 {
   for (cSatipServer *s = First(); s; s = Next(s)) {
+      if (s == serverP) {
+         s->AddTraffic(bytesP);
+         break;
+         }
+      }
+}
+
+void cSatipServers::Cleanup(uint64_t intervalMsP)
+{
+  for (cSatipServer *s = First(), *next; s; s = next) {
+      next = Next(s);
       if (!intervalMsP || (s->LastSeen() > intervalMsP)) {
          info("Removing server %s (%s %s)", s->Description(), s->Address(), s->Model());
          Del(s);
+         ++stateM;
+         }
+      }
+}
+
+int cSatipServers::Refresh(const char *addressP)
+{
+  int count = 0;
+  for (cSatipServer *s = First(); s; s = Next(s)) {
+      if (strcmp(s->Address(), addressP) == 0) {
+         s->Update();
+         if (s->IsDeparted()) {
+            info("Reactivating server %s (%s %s)", s->Description(), s->Address(), s->Model());
+            s->Depart(false);
+            s->Activate(true);
+            ++stateM;
+            }
+         ++count;
          }
       }
+  return count;
+}
+
+int cSatipServers::Depart(const char *addressP)
+{
+  int count = 0;
+  // The servers are only deactivated: active tuners keep their server and
+  // Cleanup() ages them out unless they announce themselves again
+  for (cSatipServer *s = First(); s; s = Next(s)) {
+      if ((strcmp(s->Address(), addressP) == 0) && s->IsActive()) {
+         info("Deactivating server %s (%s %s)", s->Description(), s->Address(), s->Model());
+         s->Activate(false);
+         s->Depart(true);
+         ++stateM;
+         ++count;
+         }
+      }
+  return count;
 }
 
 cString cSatipServers::GetSrcAddress(cSatipServer *serverP)
@@ -528,9 +776,9 @@ cString cSatipServers::List(void)
   cString list = "";
   for (cSatipServer *s = First(); s; s = Next(s))
       if (isempty(s->SrcAddress()))
-         list = cString::sprintf("%s%c %s|%s|%s\n", *list, s->IsActive() ? '+' : '-', s->Address(), s->Model(), s->Description());
+         list = cString::sprintf("%s%c %s|%s|%s%s\n", *list, s->IsActive() ? '+' : '-', s->Address(), s->Model(), s->Description(), s->IsProvisional() ? " (cached)" : "");
       else
-         list = cString::sprintf("%s%c %s@%s|%s|%s\n", *list, s->IsActive() ? '+' : '-', s->SrcAddress(), s->Address(), s->Model(), s->Description());
+         list = cString::sprintf("%s%c %s@%s|%s|%s%s\n", *list, s->IsActive() ? '+' : '-', s->SrcAddress(), s->Address(), s->Model(), s->Description(), s->IsProvisional() ? " (cached)" : "");
   return list;
 }
 
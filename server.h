@@ -8,6 +8,9 @@
 #ifndef __SATIP_SERVER_H
 #define __SATIP_SERVER_H
 
+#include <map>
+#include <vector>
+
 class cSatipServer;
 
 // --- cSatipFrontend ---------------------------------------------------------
@@ -35,7 +38,17 @@ public:
 // --- cSatipFrontends --------------------------------------------------------
 
 class cSatipFrontends : public cList<cSatipFrontend> {
+private:
+  // attached frontends in total and per transponder
+  int usedM;
+  std::map<int, int> transpondersM;
+  void Index(cSatipFrontend *frontendP);
+  void Unindex(cSatipFrontend *frontendP);
+
 public:
+  cSatipFrontends() : usedM(0) {}
+  int Used(void) { return usedM; }
+  bool HasTransponder(int transponderP) { return transpondersM.count(transponderP); }
   bool Matches(int deviceIdP, int transponderP);
   bool Assign(int deviceIdP, int transponderP);
   bool Attach(int deviceIdP, int transponderP);
@@ -56,7 +69,8 @@ private:
     delsysCount
   };
   enum {
-    eSatipMaxSourceFilters = 16
+    eSatipMaxSourceFilters = 16,
+    eTrafficWindowMs       = 2000 // in milliseconds
   };
   cString srcAddressM;
   cString addressM;
@@ -70,9 +84,19 @@ private:
   int quirkM;
   bool hasCiM;
   bool activeM;
+  // deactivated by an ssdp:byebye instead of the user
+  bool departedM;
+  bool provisionalM;
+  long describesM;
+  long describesAvoidedM;
   time_t createdM;
   cTimeMs lastSeenM;
+  time_t cachedSeenM;
+  long trafficBytesM;
+  long bitrateM;
+  cTimeMs trafficM;
   bool IsValidSource(int sourceP);
+  int DelSystems(int sourceP, int systemP, int *delsysP);
 
 public:
   enum eSatipQuirk {
@@ -85,7 +109,8 @@ public:
     eSatipQuirkCiTnr       = 0x20,
     eSatipQuirkForcePilot  = 0x40,
     eSatipQuirkTearAndPlay = 0x80,
-    eSatipQuirkMask        = 0xFF
+    eSatipQuirkFullMux     = 0x100,
+    eSatipQuirkMask        = 0x1FF
   };
   cSatipServer(const char *srcAddressP, const char *addressP, const int portP, const char *modelP, const char *filtersP, const char *descriptionP, const int quirkP);
   virtual ~cSatipServer();
@@ -95,6 +120,10 @@ public:
   bool Matches(int DeviceId, int Source, int DelSys, int Transponder);
   void Attach(int deviceIdP, int transponderP);
   void Detach(int deviceIdP, int transponderP);
+  bool HasTransponder(int sourceP, int systemP, int transponderP);
+  int GetLoad(int sourceP, int systemP, int &totalP);
+  void AddTraffic(long bytesP);
+  long Bitrate(void);
   int GetModulesDVBS2(void);
   int GetModulesDVBT(void);
   int GetModulesDVBT2(void);
@@ -109,29 +138,77 @@ public:
   const char *Description(void) { return *descriptionM; }
   const char *Quirks(void)      { return *quirksM; }
   int Port(void)                { return portM; }
+  int QuirkMask(void)           { return (quirkM & eSatipQuirkMask); }
   bool Quirk(int quirkP)        { return ((quirkP & eSatipQuirkMask) & quirkM); }
   bool HasQuirk(void)           { return (quirkM != eSatipQuirkNone); }
   bool HasCI(void)              { return hasCiM; }
   bool IsActive(void)           { return activeM; }
-  void Update(void)             { lastSeenM.Set(); }
+  void Depart(bool onOffP)      { departedM = onOffP; }
+  bool IsDeparted(void)         { return departedM; }
+  void Update(void)             { lastSeenM.Set(); provisionalM = false; }
+  void SetProvisional(time_t lastSeenP) { provisionalM = true; cachedSeenM = lastSeenP; }
+  bool IsProvisional(void)      { return provisionalM; }
+  time_t LastSeenTime(void)     { return provisionalM ? cachedSeenM : time(NULL) - (time_t)(lastSeenM.Elapsed() / 1000); }
+  void CountDescribe(bool avoidedP) { if (avoidedP) describesAvoidedM++; else describesM++; }
+  long Describes(void)          { return describesM; }
+  long DescribesAvoided(void)   { return describesAvoidedM; }
   uint64_t LastSeen(void)       { return lastSeenM.Elapsed(); }
   time_t Created(void)          { return createdM; }
 };
 
+// --- cSatipServerPolicy -----------------------------------------------------
+
+class cSatipServerPolicy {
+public:
+  virtual ~cSatipServerPolicy() {}
+  virtual const char *Name(void) const = 0;
+  // sorts the servers into the order they shall be tried for a new tuning
+  virtual void Order(std::vector<cSatipServer *> &serversP, int sourceP, int systemP, int transponderP) const = 0;
+  static const cSatipServerPolicy &Get(void);
+};
+
+// Tries the servers in the order they were discovered.
+class cSatipFirstServerPolicy : public cSatipServerPolicy {
+public:
+  virtual const char *Name(void) const { return "first"; }
+  virtual void Order(std::vector<cSatipServer *> &serversP, int sourceP, int systemP, int transponderP) const {}
+};
+
+// Prefers servers already tuned to the transponder, then the least loaded
+// ones and finally the ones with the lowest measured throughput.
+class cSatipLoadServerPolicy : public cSatipServerPolicy {
+public:
+  virtual const char *Name(void) const { return "load"; }
+  virtual void Order(std::vector<cSatipServer *> &serversP, int sourceP, int systemP, int transponderP) const;
+};
+
 // --- cSatipServers ----------------------------------------------------------
 
 class cSatipServers : public cList<cSatipServer> {
+private:
+  int stateM;
+  cSatipServer *Assign(std::vector<cSatipServer *> &serversP, int deviceIdP, int sourceP, int transponderP, int systemP);
+
 public:
+  cSatipServers() : stateM(0) {}
+  void Add(cSatipServer *serverP) { cList<cSatipServer>::Add(serverP); ++stateM; }
+  int State(void) { return stateM; }
   cSatipServer *Find(cSatipServer *serverP);
   cSatipServer *Find(int sourceP);
+  int Candidates(int sourceP, std::vector<cSatipServer *> &serversP);
   cSatipServer *Assign(int deviceIdP, int sourceP, int transponderP, int systemP);
+  cSatipServer *Assign(int deviceIdP, int sourceP, int transponderP, int systemP, const std::vector<cSatipServer *> &candidatesP);
   cSatipServer *Update(cSatipServer *serverP);
   void Activate(cSatipServer *serverP, bool onOffP);
   void Attach(cSatipServer *serverP, int deviceIdP, int transponderP);
   void Detach(cSatipServer *serverP, int deviceIdP, int transponderP);
   bool IsQuirk(cSatipServer *serverP, int quirkP);
   bool HasCI(cSatipServer *serverP);
+  void CountDescribe(cSatipServer *serverP, bool avoidedP);
+  void AddTraffic(cSatipServer *serverP, long bytesP);
   void Cleanup(uint64_t intervalMsP = 0);
+  int Refresh(const char *addressP);
+  int Depart(const char *addressP);
   cString GetAddress(cSatipServer *serverP);
   cString GetSrcAddress(cSatipServer *serverP);
   cString GetString(cSatipServer *serverP);
@@ -92,6 +92,7 @@ private:
   cString modelM;
   cString descriptionM;
   cString ciExtensionM;
+  cString describesM;
   uint64_t createdM;
   void Setup(void);
 
@@ -109,6 +110,7 @@ cSatipServerInfo::cSatipServerInfo(cSatipServer *serverP)
   modelM(serverP ? serverP->Model() : "---"),
   descriptionM(serverP ? serverP->Description() : "---"),
   ciExtensionM(serverP && serverP->HasCI() ? trVDR("yes") : trVDR("no")),
+  describesM(serverP ? cString::sprintf("%ld (%ld %s)", serverP->Describes(), serverP->DescribesAvoided(), tr("avoided")) : "---"),
   createdM(serverP ? serverP->Created() : 0)
 {
   SetMenuCategory(mcSetupPlugins);
@@ -127,6 +129,7 @@ void cSatipServerInfo::Setup(void)
   Add(new cOsdItem(cString::sprintf("%s:\t%s", tr("Model"),         *modelM),                osUnknown, false));
   Add(new cOsdItem(cString::sprintf("%s:\t%s", tr("Description"),   *descriptionM),          osUnknown, false));
   Add(new cOsdItem(cString::sprintf("%s:\t%s", tr("CI extension"),  *ciExtensionM),          osUnknown, false));
+  Add(new cOsdItem(cString::sprintf("%s:\t%s", tr("DESCRIBE"),      *describesM),            osUnknown, false));
   Add(new cOsdItem(cString::sprintf("%s:\t%s", tr("Creation date"), *DayDateTime(createdM)), osUnknown, false));
 }
 
@@ -346,8 +349,14 @@ cSatipPluginSetup::cSatipPluginSetup()
   deviceCountM(0),
   operatingModeM(SatipConfig.GetOperatingMode()),
   transportModeM(SatipConfig.GetTransportMode()),
+  assignPolicyM(SatipConfig.GetAssignPolicy()),
   ciExtensionM(SatipConfig.GetCIExtension()),
   frontendReuseM(SatipConfig.GetFrontendReuse()),
+  streamSharingM(SatipConfig.GetStreamSharing()),
+  dropUnrequestedM(SatipConfig.GetDropUnrequested()),
+  sectionRefreshM(SatipConfig.GetSectionRefresh()),
+  eventLoopsM(SatipConfig.GetEventLoops()),
+  idleReleaseM(SatipConfig.GetIdleRelease()),
   eitScanM(SatipConfig.GetEITScan()),
   numDisabledSourcesM(SatipConfig.GetDisabledSourcesCount()),
   numDisabledFiltersM(SatipConfig.GetDisabledFiltersCount())
@@ -360,6 +369,8 @@ cSatipPluginSetup::cSatipPluginSetup()
   transportModeTextsM[cSatipConfig::eTransportModeUnicast]    = tr("Unicast");
   transportModeTextsM[cSatipConfig::eTransportModeMulticast]  = tr("Multicast");
   transportModeTextsM[cSatipConfig::eTransportModeRtpOverTcp] = tr("RTP-over-TCP");
+  assignPolicyTextsM[cSatipConfig::eAssignPolicyFirst]        = tr("first available");
+  assignPolicyTextsM[cSatipConfig::eAssignPolicyLoad]         = tr("least loaded");
   for (unsigned int i = 0; i < ELEMENTS(cicamsM); ++i)
       cicamsM[i] = SatipConfig.GetCICAM(i);
   for (unsigned int i = 0; i < ELEMENTS(ca_systems_table); ++i)
@@ -423,6 +434,24 @@ void cSatipPluginSetup::Setup(void)
   Add(new cMenuEditBoolItem(tr("Enable frontend reuse"), &frontendReuseM));
   helpM.Append(tr("Define whether reusing a frontend for multiple channels in a transponder should be enabled."));
 
+  Add(new cMenuEditBoolItem(tr("Enable stream sharing"), &streamSharingM));
+  helpM.Append(tr("Define whether devices tuned to the same transponder should share a single SAT>IP session instead of opening one each."));
+
+  Add(new cMenuEditBoolItem(tr("Drop unrequested packets"), &dropUnrequestedM));
+  helpM.Append(tr("Define whether null packets and packets of pids that aren't requested anymore should be dropped before buffering."));
+
+  Add(new cMenuEditIntItem(tr("Section refresh interval [s]"), &sectionRefreshM, 0, 3600, tr("off")));
+  helpM.Append(tr("Define how long unchanged repetitions of a section are held back from VDR.\n\nA section is passed on again as soon as its version or content changes or this interval has elapsed."));
+
+  Add(new cMenuEditIntItem(tr("Event loop threads"), &eventLoopsM, 0, 8, tr("off")));
+  helpM.Append(tr("Define how many shared threads drive the tuners and section filters of all devices instead of a thread pair per device.\n\nThis setting will be applied after restarting VDR."));
+
+  Add(new cMenuEditIntItem(tr("Release idle devices after [s]"), &idleReleaseM, 0, 3600, tr("never")));
+  helpM.Append(tr("Define how long an untuned device keeps its buffers, sockets and threads.\n\nThey are allocated again on the next tuning."));
+
+  Add(new cMenuEditStraItem(tr("Server selection"), &assignPolicyM, ELEMENTS(assignPolicyTextsM), assignPolicyTextsM));
+  helpM.Append(tr("Define how a SAT>IP server is selected for a new transponder.\n\nfirst available - use the first server with a free frontend\nleast loaded - prefer servers already tuned to the transponder, then the ones with the most free frontends and the lowest throughput"));
+
   Add(new cOsdItem(tr("Active SAT>IP servers:"), osUnknown, false));
   helpM.Append("");
 
@@ -574,8 +603,14 @@ void cSatipPluginSetup::Store(void)
   // Store values into setup.conf
   SetupStore("OperatingMode", operatingModeM);
   SetupStore("TransportMode", transportModeM);
+  SetupStore("AssignPolicy", assignPolicyM);
   SetupStore("EnableCIExtension", ciExtensionM);
   SetupStore("EnableFrontendReuse", frontendReuseM);
+  SetupStore("EnableStreamSharing", streamSharingM);
+  SetupStore("DropUnrequested", dropUnrequestedM);
+  SetupStore("SectionRefresh", sectionRefreshM);
+  SetupStore("EventLoops", eventLoopsM);
+  SetupStore("IdleRelease", idleReleaseM);
   SetupStore("EnableEITScan", eitScanM);
   StoreCicams("CICAM", cicamsM);
   StoreSources("DisabledSources", disabledSourcesM);
@@ -583,6 +618,12 @@ void cSatipPluginSetup::Store(void)
   // Update global config
   SatipConfig.SetOperatingMode(operatingModeM);
   SatipConfig.SetTransportMode(transportModeM);
+  SatipConfig.SetAssignPolicy(assignPolicyM);
+  SatipConfig.SetStreamSharing(streamSharingM);
+  SatipConfig.SetDropUnrequested(dropUnrequestedM);
+  SatipConfig.SetSectionRefresh(sectionRefreshM);
+  SatipConfig.SetEventLoops(eventLoopsM);
+  SatipConfig.SetIdleRelease(idleReleaseM);
   SatipConfig.SetCIExtension(ciExtensionM);
   SatipConfig.SetEITScan(eitScanM);
   for (int i = 0; i < MAX_CICAM_COUNT; ++i)
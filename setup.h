@@ -21,8 +21,15 @@ private:
   int transportModeM;
   const char *operatingModeTextsM[cSatipConfig::eOperatingModeCount];
   const char *transportModeTextsM[cSatipConfig::eTransportModeCount];
+  int assignPolicyM;
+  const char *assignPolicyTextsM[cSatipConfig::eAssignPolicyCount];
   int ciExtensionM;
   int frontendReuseM;
+  int streamSharingM;
+  int dropUnrequestedM;
+  int sectionRefreshM;
+  int eventLoopsM;
+  int idleReleaseM;
   int cicamsM[MAX_CICAM_COUNT];
   const char *cicamTextsM[CA_SYSTEMS_TABLE_SIZE];
   int eitScanM;
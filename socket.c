@@ -114,10 +114,10 @@ bool cSatipSocket::Open(const int portP, const bool reuseP)
   return true;
 }
 
-bool cSatipSocket::OpenMulticast(const int portP, const char *streamAddrP, const char *sourceAddrP)
+bool cSatipSocket::OpenMulticast(const int portP, const char *streamAddrP, const char *sourceAddrP, const bool reuseP)
 {
-  dbg_funcname("%s (%d, %s, %s)", __PRETTY_FUNCTION__, portP, streamAddrP, sourceAddrP);
-  if (Open(portP)) {
+  dbg_funcname("%s (%d, %s, %s, %d)", __PRETTY_FUNCTION__, portP, streamAddrP, sourceAddrP, reuseP);
+  if (Open(portP, reuseP)) {
      CheckAddress(streamAddrP, &streamAddrM);
      if (!isempty(sourceAddrP))
         useSsmM = CheckAddress(sourceAddrP, &sourceAddrM);
@@ -30,7 +30,7 @@ public:
   explicit cSatipSocket(size_t rcvBufSizeP);
   virtual ~cSatipSocket();
   bool Open(const int portP = 0, const bool reuseP = false);
-  bool OpenMulticast(const int portP, const char *streamAddrP, const char *sourceAddrP);
+  bool OpenMulticast(const int portP, const char *streamAddrP, const char *sourceAddrP, const bool reuseP = false);
   virtual void Close(void);
   int Fd(void) { return socketDescM; }
   int Port(void) { return socketPortM; }
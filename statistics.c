@@ -16,6 +16,8 @@
 cSatipSectionStatistics::cSatipSectionStatistics()
 : filteredDataM(0),
   numberOfCallsM(0),
+  suppressedCallsM(0),
+  crcErrorsM(0),
   timerM(),
   mutexM()
 {
@@ -39,7 +41,11 @@ cString cSatipSectionStatistics::GetSectionStatistic()
   // no trailing linefeed here!
   cString s = cString::sprintf("%4ld (%4ld k%s/s)", numberOfCallsM, bitrate,
                                SatipConfig.GetUseBytes() ? "B" : "bit");
-  filteredDataM = numberOfCallsM = 0;
+  if (suppressedCallsM)
+     s = cString::sprintf("%s %4ld suppressed", *s, suppressedCallsM);
+  if (crcErrorsM)
+     s = cString::sprintf("%s %4ld crc errors", *s, crcErrorsM);
+  filteredDataM = numberOfCallsM = suppressedCallsM = crcErrorsM = 0;
   return s;
 }
 
@@ -51,6 +57,20 @@ void cSatipSectionStatistics::AddSectionStatistic(long bytesP, long callsP)
   numberOfCallsM += callsP;
 }
 
+void cSatipSectionStatistics::AddSuppressedStatistic(long callsP)
+{
+  dbg_funcname_ext("%s (%ld)", __PRETTY_FUNCTION__, callsP);
+  cMutexLock MutexLock(&mutexM);
+  suppressedCallsM += callsP;
+}
+
+void cSatipSectionStatistics::AddCrcErrorStatistic(long callsP)
+{
+  dbg_funcname_ext("%s (%ld)", __PRETTY_FUNCTION__, callsP);
+  cMutexLock MutexLock(&mutexM);
+  crcErrorsM += callsP;
+}
+
 // --- cSatipPidStatistics ----------------------------------------------------
 
 // Device statistics class
@@ -137,6 +157,13 @@ void cSatipPidStatistics::AddPidStatistic(int pidP, long payloadP)
 // Tuner statistics class
 cSatipTunerStatistics::cSatipTunerStatistics()
 : dataBytesM(0),
+  droppedNullsM(0),
+  droppedUnrequestedM(0),
+  lockWaitsM(0),
+  lockTimeoutsM(0),
+  lockWaitLastUsM(0),
+  lockWaitMaxUsM(0),
+  lockWaitTotalUsM(0),
   timerM(),
   mutexM()
 {
@@ -171,6 +198,136 @@ void cSatipTunerStatistics::AddTunerStatistic(long bytesP)
   dataBytesM += bytesP;
 }
 
+cString cSatipTunerStatistics::GetLockWaitStatistic()
+{
+  dbg_funcname_ext("%s", __PRETTY_FUNCTION__);
+  cMutexLock MutexLock(&mutexM);
+  return cString::sprintf("%ld waits, %ld timeouts, last %ld us, avg %lld us, max %ld us",
+                          lockWaitsM, lockTimeoutsM, lockWaitLastUsM,
+                          lockWaitsM ? lockWaitTotalUsM / lockWaitsM : 0LL, lockWaitMaxUsM);
+}
+
+void cSatipTunerStatistics::AddLockWaitStatistic(long waitUsP, bool lockedP)
+{
+  dbg_funcname_ext("%s (%ld, %d)", __PRETTY_FUNCTION__, waitUsP, lockedP);
+  cMutexLock MutexLock(&mutexM);
+  lockWaitsM++;
+  if (!lockedP)
+     lockTimeoutsM++;
+  lockWaitLastUsM = waitUsP;
+  lockWaitTotalUsM += waitUsP;
+  if (waitUsP > lockWaitMaxUsM)
+     lockWaitMaxUsM = waitUsP;
+}
+
+cString cSatipTunerStatistics::GetDropStatistic()
+{
+  dbg_funcname_ext("%s", __PRETTY_FUNCTION__);
+  cMutexLock MutexLock(&mutexM);
+  return cString::sprintf("%ld null, %ld unrequested", droppedNullsM, droppedUnrequestedM);
+}
+
+void cSatipTunerStatistics::AddDropStatistic(long nullsP, long unrequestedP)
+{
+  dbg_funcname_ext("%s (%ld, %ld)", __PRETTY_FUNCTION__, nullsP, unrequestedP);
+  cMutexLock MutexLock(&mutexM);
+  droppedNullsM += nullsP;
+  droppedUnrequestedM += unrequestedP;
+}
+
+
+// Continuity statistics class
+cSatipContinuityStatistics::cSatipContinuityStatistics()
+: ccErrorCountM(0),
+  duplicateCountM(0),
+  transportErrorCountM(0),
+  mutexM()
+{
+  dbg_funcname("%s", __PRETTY_FUNCTION__);
+  ResetContinuityStatistic();
+}
+
+cSatipContinuityStatistics::~cSatipContinuityStatistics()
+{
+  dbg_funcname("%s", __PRETTY_FUNCTION__);
+}
+
+cString cSatipContinuityStatistics::GetContinuityStatistic()
+{
+  dbg_funcname_ext("%s", __PRETTY_FUNCTION__);
+  cMutexLock MutexLock(&mutexM);
+  cString s = cString::sprintf("Continuity: %ld cc errors, %ld duplicates, %ld transport errors\n", ccErrorCountM, duplicateCountM, transportErrorCountM);
+  for (int i = 0; i < eMaxPids; ++i) {
+      if (ccErrorsM[i] || duplicatesM[i] || transportErrorsM[i])
+         s = cString::sprintf("%sPid %4d: %u cc, %u dup, %u tei\n", *s, i, ccErrorsM[i], duplicatesM[i], transportErrorsM[i]);
+      }
+  return s;
+}
+
+void cSatipContinuityStatistics::AddContinuityStatistic(const u_char *bufferP, int lengthP)
+{
+  dbg_funcname_ext("%s (, %d)", __PRETTY_FUNCTION__, lengthP);
+  cMutexLock MutexLock(&mutexM);
+  for (int i = 0; i + TS_SIZE <= lengthP; i += TS_SIZE) {
+      const u_char *p = bufferP + i;
+      if (p[0] != TS_SYNC_BYTE)
+         continue;
+      int pid = ts_pid(p);
+      if (pid == 0x1FFF)
+         continue;
+      // Corrupted packets are reported by the frontend of the server
+      if (p[1] & TS_ERROR) {
+         ++transportErrorsM[pid];
+         ++transportErrorCountM;
+         continue;
+         }
+      // The counter is only incremented by packets with payload
+      if (!(p[3] & TS_PAYLOAD_EXISTS))
+         continue;
+      uint8_t cc = p[3] & TS_CONT_CNT_MASK;
+      uint8_t state = lastCcM[pid];
+      if ((p[3] & TS_ADAPT_FIELD_EXISTS) && p[4] && (p[5] & 0x80))
+         state = eCcUnknown; // discontinuity indicator
+      if (!(state & eCcUnknown)) {
+         uint8_t last = state & eCcMask;
+         if (cc == last) {
+            // A single duplicate is allowed, the following ones are errors
+            if (!(state & eCcDuplicate)) {
+               ++duplicatesM[pid];
+               ++duplicateCountM;
+               lastCcM[pid] = cc | eCcDuplicate;
+               continue;
+               }
+            ++ccErrorsM[pid];
+            ++ccErrorCountM;
+            }
+         else if (cc != ((last + 1) & eCcMask)) {
+            ++ccErrorsM[pid];
+            ++ccErrorCountM;
+            }
+         }
+      lastCcM[pid] = cc;
+      }
+}
+
+void cSatipContinuityStatistics::ResetContinuityStatistic(int pidP)
+{
+  dbg_funcname_ext("%s (%d)", __PRETTY_FUNCTION__, pidP);
+  cMutexLock MutexLock(&mutexM);
+  if ((pidP >= 0) && (pidP < eMaxPids)) {
+     // Forget only the last counter of a newly requested pid
+     lastCcM[pidP] = eCcUnknown;
+     return;
+     }
+  memset(lastCcM, eCcUnknown, sizeof(lastCcM));
+  memset(ccErrorsM, 0, sizeof(ccErrorsM));
+  memset(duplicatesM, 0, sizeof(duplicatesM));
+  memset(transportErrorsM, 0, sizeof(transportErrorsM));
+  ccErrorCountM = 0;
+  duplicateCountM = 0;
+  transportErrorCountM = 0;
+}
+
 
 // Buffer statistics class
 cSatipBufferStatistics::cSatipBufferStatistics()
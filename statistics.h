@@ -19,10 +19,14 @@ public:
 
 protected:
   void AddSectionStatistic(long bytesP, long callsP);
+  void AddSuppressedStatistic(long callsP);
+  void AddCrcErrorStatistic(long callsP);
 
 private:
   long filteredDataM;
   long numberOfCallsM;
+  long suppressedCallsM;
+  long crcErrorsM;
   cTimeMs timerM;
   cMutex mutexM;
 };
@@ -56,16 +60,56 @@ public:
   cSatipTunerStatistics();
   virtual ~cSatipTunerStatistics();
   cString GetTunerStatistic();
+  cString GetLockWaitStatistic();
+  cString GetDropStatistic();
 
 protected:
   void AddTunerStatistic(long bytesP);
+  void AddLockWaitStatistic(long waitUsP, bool lockedP);
+  void AddDropStatistic(long nullsP, long unrequestedP);
 
 private:
   long dataBytesM;
+  long droppedNullsM;
+  long droppedUnrequestedM;
+  long lockWaitsM;
+  long lockTimeoutsM;
+  long lockWaitLastUsM;
+  long lockWaitMaxUsM;
+  long long lockWaitTotalUsM;
   cTimeMs timerM;
   cMutex mutexM;
 };
 
+// Continuity statistics
+class cSatipContinuityStatistics {
+public:
+  cSatipContinuityStatistics();
+  virtual ~cSatipContinuityStatistics();
+  cString GetContinuityStatistic();
+
+protected:
+  void AddContinuityStatistic(const u_char *bufferP, int lengthP);
+  void ResetContinuityStatistic(int pidP = -1);
+
+private:
+  enum {
+    eMaxPids        = 8192,
+    eCcMask         = 0x0F,
+    eCcDuplicate    = 0x10,
+    eCcUnknown      = 0x80
+  };
+  // the last continuity counter and state flags of each pid
+  uint8_t lastCcM[eMaxPids];
+  uint32_t ccErrorsM[eMaxPids];
+  uint32_t duplicatesM[eMaxPids];
+  uint32_t transportErrorsM[eMaxPids];
+  long ccErrorCountM;
+  long duplicateCountM;
+  long transportErrorCountM;
+  cMutex mutexM;
+};
+
 // Buffer statistics
 class cSatipBufferStatistics {
 public:
@@ -0,0 +1,166 @@
+/*
+ * tunecache.c: SAT>IP plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <vdr/dvbdevice.h>
+
+#include "config.h"
+#include "common.h"
+#include "discover.h"
+#include "log.h"
+#include "param.h"
+#include "tunecache.h"
+
+cSatipTuneCache *cSatipTuneCache::instanceS = NULL;
+
+cSatipTuneCache *cSatipTuneCache::GetInstance(void)
+{
+  if (!instanceS)
+     instanceS = new cSatipTuneCache();
+  return instanceS;
+}
+
+bool cSatipTuneCache::Initialize(void)
+{
+  dbg_funcname("%s", __PRETTY_FUNCTION__);
+  // cStatus objects must be created in the main thread
+  if (instanceS && !instanceS->monitorM)
+     instanceS->monitorM = new cChannelMonitor(*instanceS);
+  return true;
+}
+
+void cSatipTuneCache::Destroy(void)
+{
+  dbg_funcname("%s", __PRETTY_FUNCTION__);
+  if (instanceS) {
+     DELETE_POINTER(instanceS->monitorM);
+     instanceS->Invalidate();
+     }
+}
+
+cSatipTuneCache::cSatipTuneCache()
+: mutexM(),
+  monitorM(NULL),
+  entriesM(),
+  hitsM(0),
+  missesM(0),
+  useCountM(0)
+{
+  dbg_funcname("%s", __PRETTY_FUNCTION__);
+}
+
+cSatipTuneCache::~cSatipTuneCache()
+{
+  dbg_funcname("%s", __PRETTY_FUNCTION__);
+  DELETE_POINTER(monitorM);
+}
+
+uint64_t cSatipTuneCache::Key(const cChannel *channelP)
+{
+  // FNV-1a over everything the query is built from
+  uint64_t h = 14695981039346656037ULL;
+  int values[] = { channelP->Source(), channelP->Transponder(), channelP->Frequency(), channelP->Srate(), channelP->Rid() % 100 };
+  for (unsigned int i = 0; i < ELEMENTS(values); ++i) {
+      for (unsigned int j = 0; j < sizeof(int); ++j) {
+          h ^= (values[i] >> (j * 8)) & 0xFF;
+          h *= 1099511628211ULL;
+          }
+      }
+  for (const char *p = channelP->Parameters(); p && *p; ++p) {
+      h ^= (unsigned char)*p;
+      h *= 1099511628211ULL;
+      }
+  return h;
+}
+
+std::vector<int> cSatipTuneCache::TnrKey(const cChannel *channelP)
+{
+  // everything besides the tuning parameters GetTnrUrlParameters() depends on
+  return { channelP->Sid(), channelP->Vpid(), channelP->Ppid(), channelP->Apid(0), channelP->Dpid(0),
+           channelP->Tid(), channelP->Nid(), channelP->Ca(), Setup.LnbSLOF,
+           cDevice::PrimaryDevice()->GetCurrentAudioTrack() };
+}
+
+cSatipTuneDescriptor *cSatipTuneCache::Find(const cChannel *channelP)
+{
+  auto it = entriesM.find(Key(channelP));
+  if ((it != entriesM.end()) && (it->second.source == channelP->Source()) &&
+      (it->second.transponder == channelP->Transponder()) && (it->second.frequency == channelP->Frequency()) &&
+      (it->second.srate == channelP->Srate()) &&
+      (it->second.frontend == channelP->Rid() % 100) && (it->second.parameters == channelP->Parameters()))
+     return &it->second;
+  return NULL;
+}
+
+void cSatipTuneCache::Evict(void)
+{
+  // drop only the least recently used entry to keep the working set of an EPG scan
+  auto oldest = entriesM.begin();
+  for (auto it = entriesM.begin(); it != entriesM.end(); ++it) {
+      if (it->second.lastUse < oldest->second.lastUse)
+         oldest = it;
+      }
+  if (oldest != entriesM.end())
+     entriesM.erase(oldest);
+}
+
+bool cSatipTuneCache::Get(const cChannel *channelP, cSatipTuneDescriptor &descriptorP)
+{
+  if (!channelP)
+     return false;
+  cMutexLock MutexLock(&mutexM);
+  cSatipTuneDescriptor *d = Find(channelP);
+  if (!d) {
+     std::string query = GetTransponderUrlParameters(channelP);
+     if (query.empty())
+        return false;
+     if (entriesM.size() >= eMaxEntries)
+        Evict();
+     d = &entriesM[Key(channelP)];
+     *d = cSatipTuneDescriptor();
+     d->source = channelP->Source();
+     d->transponder = channelP->Transponder();
+     d->frequency = channelP->Frequency();
+     d->srate = channelP->Srate();
+     d->frontend = channelP->Rid() % 100;
+     d->parameters = channelP->Parameters();
+     d->query = query;
+     d->system = cDvbTransponderParameters(channelP->Parameters()).System();
+     ++missesM;
+     }
+  else
+     ++hitsM;
+  d->lastUse = ++useCountM;
+  // Refresh the candidate servers whenever the server list has changed
+  if (d->serversState != cSatipDiscover::GetInstance()->GetServersState())
+     d->serversState = cSatipDiscover::GetInstance()->GetCandidateServers(d->source, d->servers);
+  dbg_chan_switch("%s (%d) hits=%d misses=%d entries=%zu", __PRETTY_FUNCTION__, channelP->Number(), hitsM, missesM, entriesM.size());
+  descriptorP = *d;
+  return true;
+}
+
+cString cSatipTuneCache::GetTnr(const cChannel *channelP)
+{
+  if (!channelP)
+     return "";
+  cMutexLock MutexLock(&mutexM);
+  cSatipTuneDescriptor *d = Find(channelP);
+  if (!d)
+     return GetTnrUrlParameters(channelP).c_str();
+  std::vector<int> key = TnrKey(channelP);
+  if (d->tnrKey != key) {
+     d->tnrKey = key;
+     d->tnr = GetTnrUrlParameters(channelP).c_str();
+     }
+  return d->tnr;
+}
+
+void cSatipTuneCache::Invalidate(void)
+{
+  cMutexLock MutexLock(&mutexM);
+  dbg_chan_switch("%s entries=%zu", __PRETTY_FUNCTION__, entriesM.size());
+  entriesM.clear();
+}
@@ -0,0 +1,91 @@
+/*
+ * tunecache.h: SAT>IP plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __SATIP_TUNECACHE_H
+#define __SATIP_TUNECACHE_H
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vdr/channels.h>
+#include <vdr/status.h>
+#include <vdr/thread.h>
+#include <vdr/tools.h>
+
+#include "server.h"
+
+// --- cSatipTuneDescriptor ---------------------------------------------------
+
+// Everything SetChannelDevice() derives from a channel, precomputed once
+// per (source, transponder, parameters).
+class cSatipTuneDescriptor {
+public:
+  int source;
+  int transponder;
+  int frequency;
+  int srate;
+  int frontend;
+  std::string parameters;
+  std::string query;
+  int system;
+  int serversState;
+  std::vector<cSatipServer *> servers;
+  // the tnr string depends on the service, so only the latest one is kept
+  std::vector<int> tnrKey;
+  cString tnr;
+  // for the least recently used eviction
+  uint64_t lastUse;
+  cSatipTuneDescriptor() : source(0), transponder(0), frequency(0), srate(0), frontend(0), system(0), serversState(-1), tnr(""), lastUse(0) {}
+};
+
+// --- cSatipTuneCache --------------------------------------------------------
+
+class cSatipTuneCache {
+private:
+  enum {
+    eMaxEntries = 512
+  };
+  class cChannelMonitor : public cStatus {
+  private:
+    cSatipTuneCache &cacheM;
+  protected:
+#if APIVERSNUM >= 20400
+    virtual void ChannelChange(const cChannel *channelP) { cacheM.Invalidate(); }
+#endif
+  public:
+    explicit cChannelMonitor(cSatipTuneCache &cacheP) : cacheM(cacheP) {}
+  };
+  static cSatipTuneCache *instanceS;
+  cMutex mutexM;
+  cChannelMonitor *monitorM;
+  std::unordered_map<uint64_t, cSatipTuneDescriptor> entriesM;
+  int hitsM;
+  int missesM;
+  uint64_t useCountM;
+  static uint64_t Key(const cChannel *channelP);
+  static std::vector<int> TnrKey(const cChannel *channelP);
+  cSatipTuneDescriptor *Find(const cChannel *channelP);
+  void Evict(void);
+  // constructor
+  cSatipTuneCache();
+  // to prevent copy constructor and assignment
+  cSatipTuneCache(const cSatipTuneCache&);
+  cSatipTuneCache& operator=(const cSatipTuneCache&);
+
+public:
+  static cSatipTuneCache *GetInstance(void);
+  static bool Initialize(void);
+  static void Destroy(void);
+  virtual ~cSatipTuneCache();
+  bool Get(const cChannel *channelP, cSatipTuneDescriptor &descriptorP);
+  cString GetTnr(const cChannel *channelP);
+  void Invalidate(void);
+};
+
+#endif // __SATIP_TUNECACHE_H
@@ -5,20 +5,20 @@
  *
  */
 
+#include <chrono>
 #include <cinttypes>
-#include <iostream>
-#include <sstream>
+#include <string_view>
 
 #include "common.h"
 #include "config.h"
 #include "discover.h"
+#include "eventloop.h"
 #include "log.h"
 #include "poller.h"
 #include "tuner.h"
 #include "param.h"
 #include "device.h"
 #include <vdr/channels.h>
-#include <repfunc.h>
 
 cSatipTuner::cSatipTuner(cSatipDevice& deviceP, unsigned int packetLenP)
 : cThread(cString::sprintf("SATIP#%d tuner", deviceP.GetId())),
@@ -37,9 +37,22 @@ cSatipTuner::cSatipTuner(cSatipDevice& deviceP, unsigned int packetLenP)
   currentServerM(NULL, deviceP.GetId(), 0),
   nextServerM(NULL, deviceP.GetId(), 0),
   mutexM(),
-  reConnectM(),
+  lockMutexM(),
+  lockChangedM(),
+  subscribersMutexM(),
+  subscribersM(),
+  subscriberBitmapsM(),
+  fullMuxM(false),
+  reConnectM(eConnectTimeoutMs),
+  idleCheckM(eIdleCheckTimeoutMs),
+  tuningM(eTuningTimeoutMs),
+  lastIdleStatusM(false),
+  loopM(cSatipEventLoop::Get(deviceP.GetId())),
+  trafficReportM(),
+  trafficM(0),
   keepAliveM(),
   statusUpdateM(),
+  rtcpUpdateM(),
   pidUpdateCacheM(),
   setupTimeoutM(-1),
   sessionM(""),
@@ -56,9 +69,33 @@ cSatipTuner::cSatipTuner(cSatipDevice& deviceP, unsigned int packetLenP)
   pmtPidM(-1),
   addPidsM(),
   delPidsM(),
-  pidsM()
+  pidsM(),
+  ownerPidsM(),
+  ownerBitmapsM(),
+  hostBitmapM(&ownerBitmapsM[deviceP.GetId()]),
+  activePidsM(),
+  transponderHashM(0),
+  activeM(false)
 {
   dbg_funcname("%s (, %d) [device %d]", __PRETTY_FUNCTION__, packetLenP, deviceIdM);
+}
+
+cSatipTuner::~cSatipTuner()
+{
+  dbg_funcname("%s [device %d]", __PRETTY_FUNCTION__, deviceIdM);
+
+  Deactivate();
+  Close();
+  currentStateM = tsIdle;
+  internalStateM.Clear();
+  externalStateM.Clear();
+}
+
+bool cSatipTuner::Activate(void)
+{
+  if (activeM)
+     return true;
+  dbg_funcname("%s [device %d]", __PRETTY_FUNCTION__, deviceIdM);
 
   // Open sockets
   int i = SatipConfig.GetPortRangeStart() ? SatipConfig.GetPortRangeStop() - SatipConfig.GetPortRangeStart() - 1 : 100;
@@ -79,124 +116,152 @@ cSatipTuner::cSatipTuner(cSatipDevice& deviceP, unsigned int packetLenP)
   cSatipPoller::GetInstance()->Register(rtpM);
   cSatipPoller::GetInstance()->Register(rtcpM);
 
-  // Start thread
-  Start();
+  // Start thread or let the event loop drive the tuner
+  if (loopM)
+     loopM->Attach(this);
+  else
+     Start();
+  activeM = true;
+  return true;
 }
 
-cSatipTuner::~cSatipTuner()
+void cSatipTuner::Deactivate(void)
 {
+  if (!activeM)
+     return;
   dbg_funcname("%s [device %d]", __PRETTY_FUNCTION__, deviceIdM);
 
   // Stop thread
+  if (loopM)
+     loopM->Detach(this);
   sleepM.Signal();
   if (Running())
      Cancel(3);
-  Close();
-  currentStateM = tsIdle;
-  internalStateM.Clear();
-  externalStateM.Clear();
 
-  // Close the listening sockets
+  // Close the listening sockets, no data is processed afterwards
   cSatipPoller::GetInstance()->Unregister(rtcpM);
   cSatipPoller::GetInstance()->Unregister(rtpM);
   rtcpM.Close();
   rtpM.Close();
+  activeM = false;
 }
 
 void cSatipTuner::Action(void)
 {
   dbg_funcname("%s Entering [device %d]", __PRETTY_FUNCTION__, deviceIdM);
 
-  bool lastIdleStatus = false;
-  cTimeMs idleCheck(eIdleCheckTimeoutMs);
-  cTimeMs tuning(eTuningTimeoutMs);
-  reConnectM.Set(eConnectTimeoutMs);
   // Do the thread loop
   while (Running()) {
-        UpdateCurrentState();
-        switch (currentStateM) {
-          case tsIdle:
-               dbg_tunerstate("%s: tsIdle [device %d]", __PRETTY_FUNCTION__, deviceIdM);
-               break;
-          case tsRelease:
-               dbg_tunerstate("%s: tsRelease [device %d]", __PRETTY_FUNCTION__, deviceIdM);
-               Disconnect();
-               RequestState(tsIdle, smInternal);
-               break;
-          case tsSet:
-               dbg_tunerstate("%s: tsSet [device %d]", __PRETTY_FUNCTION__, deviceIdM);
-               if (currentServerM.IsQuirk(cSatipServer::eSatipQuirkTearAndPlay))
-                  Disconnect();
-               if (Connect()) {
-                  tuning.Set(eTuningTimeoutMs);
-                  RequestState(tsTuned, smInternal);
-                  UpdatePids(true);
-                  }
-               else
-                  Disconnect();
-               break;
-          case tsTuned:
-               dbg_tunerstate("%s: tsTuned [device %d]", __PRETTY_FUNCTION__, deviceIdM);
-               deviceM.SetChannelTuned();
-               reConnectM.Set(eConnectTimeoutMs);
-               idleCheck.Set(eIdleCheckTimeoutMs);
-               lastIdleStatus = false;
-               // Read reception statistics via DESCRIBE and RTCP
-               if (hasLockM || ReadReceptionStatus()) {
-                  // Quirk for devices without valid reception data
-                  if (currentServerM.IsQuirk(cSatipServer::eSatipQuirkForceLock)) {
-                     hasLockM = true;
-                     signalStrengthDBmM = eDefaultSignalStrengthDBm;
-                     signalStrengthM = eDefaultSignalStrength;
-                     signalQualityM = eDefaultSignalQuality;
-                     }
-                  if (hasLockM)
-                     RequestState(tsLocked, smInternal);
-                  }
-               else if (tuning.TimedOut()) {
-                  error("Tuning timeout - retuning [device %d]", deviceIdM);
-                  RequestState(tsSet, smInternal);
-                  }
-               break;
-          case tsLocked:
-               dbg_tunerstate("%s: tsLocked [device %d]", __PRETTY_FUNCTION__, deviceIdM);
-               if (!UpdatePids()) {
-                  error("Pid update failed - retuning [device %d]", deviceIdM);
-                  RequestState(tsSet, smInternal);
-                  break;
-                  }
-               if (!KeepAlive()) {
-                  error("Keep-alive failed - retuning [device %d]", deviceIdM);
-                  RequestState(tsSet, smInternal);
-                  break;
-                  }
-               if (reConnectM.TimedOut()) {
-                  error("Connection timeout - retuning [device %d]", deviceIdM);
-                  RequestState(tsSet, smInternal);
-                  break;
-                  }
-               if (idleCheck.TimedOut()) {
-                  bool currentIdleStatus = deviceM.IsIdle();
-                  if (lastIdleStatus && currentIdleStatus) {
-                     info("Idle timeout - releasing [device %d]", deviceIdM);
-                     RequestState(tsRelease, smInternal);
-                     }
-                  lastIdleStatus = currentIdleStatus;
-                  idleCheck.Set(eIdleCheckTimeoutMs);
-                  break;
-                  }
-               Receive();
-               break;
-          default:
-               error("Unknown tuner status %d [device %d]", currentStateM, deviceIdM);
-               break;
-          }
-        if (!StateRequested())
-           sleepM.Wait(eSleepTimeoutMs); // to avoid busy loop and reduce cpu load
+        int timeout = RunOnce();
+        if (timeout > 0)
+           sleepM.Wait(timeout); // to avoid busy loop and reduce cpu load
         }
   dbg_funcname("%s Exiting [device %d]", __PRETTY_FUNCTION__, deviceIdM);
 }
 
+int cSatipTuner::RunOnce(void)
+{
+  // Retune a device whose shared stream has ended
+  deviceM.ResumeStream();
+  UpdateCurrentState();
+  switch (currentStateM) {
+    case tsIdle:
+         dbg_tunerstate("%s: tsIdle [device %d]", __PRETTY_FUNCTION__, deviceIdM);
+         break;
+    case tsRelease:
+         dbg_tunerstate("%s: tsRelease [device %d]", __PRETTY_FUNCTION__, deviceIdM);
+         Disconnect();
+         RequestState(tsIdle, smInternal);
+         break;
+    case tsSet:
+         dbg_tunerstate("%s: tsSet [device %d]", __PRETTY_FUNCTION__, deviceIdM);
+         if (currentServerM.IsQuirk(cSatipServer::eSatipQuirkTearAndPlay))
+            Disconnect();
+         if (Connect()) {
+            tuningM.Set(eTuningTimeoutMs);
+            RequestState(tsTuned, smInternal);
+            UpdatePids(true);
+            }
+         else
+            Disconnect();
+         break;
+    case tsTuned:
+         dbg_tunerstate("%s: tsTuned [device %d]", __PRETTY_FUNCTION__, deviceIdM);
+         deviceM.SetChannelTuned();
+         reConnectM.Set(eConnectTimeoutMs);
+         idleCheckM.Set(eIdleCheckTimeoutMs);
+         lastIdleStatusM = false;
+         // Read reception statistics via DESCRIBE and RTCP
+         if (hasLockM || ReadReceptionStatus()) {
+            // Quirk for devices without valid reception data
+            if (currentServerM.IsQuirk(cSatipServer::eSatipQuirkForceLock)) {
+               SetLock(true);
+               signalStrengthDBmM = eDefaultSignalStrengthDBm;
+               signalStrengthM = eDefaultSignalStrength;
+               signalQualityM = eDefaultSignalQuality;
+               }
+            if (hasLockM)
+               RequestState(tsLocked, smInternal);
+            }
+         else if (tuningM.TimedOut()) {
+            error("Tuning timeout - retuning [device %d]", deviceIdM);
+            RequestState(tsSet, smInternal);
+            }
+         break;
+    case tsLocked:
+         dbg_tunerstate("%s: tsLocked [device %d]", __PRETTY_FUNCTION__, deviceIdM);
+         if (!UpdatePids()) {
+            error("Pid update failed - retuning [device %d]", deviceIdM);
+            RequestState(tsSet, smInternal);
+            break;
+            }
+         if (!KeepAlive()) {
+            error("Keep-alive failed - retuning [device %d]", deviceIdM);
+            RequestState(tsSet, smInternal);
+            break;
+            }
+         if (reConnectM.TimedOut()) {
+            error("Connection timeout - retuning [device %d]", deviceIdM);
+            RequestState(tsSet, smInternal);
+            break;
+            }
+         if (idleCheckM.TimedOut()) {
+            bool currentIdleStatus = deviceM.IsIdle() && !Subscribers();
+            if (lastIdleStatusM && currentIdleStatus) {
+               info("Idle timeout - releasing [device %d]", deviceIdM);
+               RequestState(tsRelease, smInternal);
+               }
+            lastIdleStatusM = currentIdleStatus;
+            idleCheckM.Set(eIdleCheckTimeoutMs);
+            break;
+            }
+         Receive();
+         // Feed the server throughput used for the server selection
+         if (trafficReportM.TimedOut()) {
+            currentServerM.AddTraffic(trafficM.exchange(0));
+            trafficReportM.Set(eTrafficReportIntervalMs);
+            }
+         break;
+    default:
+         error("Unknown tuner status %d [device %d]", currentStateM, deviceIdM);
+         break;
+    }
+  return StateRequested() ? 0 : eSleepTimeoutMs;
+}
+
+cString cSatipTuner::ToString(void) const
+{
+  return cString::sprintf("Tuner [device %d]", deviceIdM);
+}
+
+void cSatipTuner::Wakeup(void)
+{
+  if (loopM)
+     loopM->Wakeup(this);
+  else
+     sleepM.Signal();
+}
+
 bool cSatipTuner::Open(void)
 {
   cMutexLock MutexLock(&mutexM);
@@ -211,7 +276,8 @@ bool cSatipTuner::Close(void)
   cMutexLock MutexLock(&mutexM);
   dbg_funcname("%s [device %d]", __PRETTY_FUNCTION__, deviceIdM);
 
-  if (setupTimeoutM.TimedOut())
+  // Keep the session as long as other devices share it
+  if (setupTimeoutM.TimedOut() && !Subscribers())
      RequestState(tsRelease, smExternal);
 
   // return always true
@@ -281,7 +347,9 @@ bool cSatipTuner::Disconnect(void)
      }
 
   // Reset signal parameters
-  hasLockM = false;
+  SetLock(false);
+  transponderHashM = 0;
+  fullMuxM = false;
   signalStrengthDBmM = 0.0;
   signalStrengthM = -1;
   signalQualityM = -1;
@@ -289,6 +357,7 @@ bool cSatipTuner::Disconnect(void)
 
   currentServerM.Detach();
   statusUpdateM.Set(0);
+  rtcpUpdateM.Set(0);
   timeoutM = eMinKeepAliveIntervalMs - eKeepAlivePreBufferMs;
   pmtPidM = -1;
   addPidsM.Clear();
@@ -306,12 +375,31 @@ void cSatipTuner::ProcessVideoData(u_char *bufferP, int lengthP)
      cTimeMs processing(0);
 
      AddTunerStatistic(lengthP);
+     AddContinuityStatistic(bufferP, lengthP);
+     trafficM += lengthP;
      elapsed = processing.Elapsed();
      if (elapsed > 1)
         dbg_rtp_perf("%s AddTunerStatistic() took %" PRIu64 " ms [device %d]", __PRETTY_FUNCTION__, elapsed, deviceIdM);
 
      processing.Set(0);
-     deviceM.WriteData(bufferP, lengthP);
+     if (fullMuxM || SatipConfig.GetDropUnrequested()) {
+        // Each device gets only its own pids out of the full transponder,
+        // otherwise only stuffing and no longer requested pids are dropped
+        int nulls = 0;
+        int dropped = Demux(deviceM, fullMuxM ? *hostBitmapM : activePidsM, bufferP, lengthP, &nulls);
+        AddDropStatistic(nulls, dropped - nulls);
+        subscribersMutexM.Lock();
+        for (int i = 0; i < subscribersM.Size(); ++i)
+            Demux(*subscribersM[i], fullMuxM ? *subscriberBitmapsM[i] : activePidsM, bufferP, lengthP);
+        subscribersMutexM.Unlock();
+        }
+     else {
+        deviceM.WriteData(bufferP, lengthP);
+        subscribersMutexM.Lock();
+        for (int i = 0; i < subscribersM.Size(); ++i)
+            subscribersM[i]->WriteData(bufferP, lengthP);
+        subscribersMutexM.Unlock();
+        }
      elapsed = processing.Elapsed();
      if (elapsed > 1)
         dbg_rtp_perf("%s WriteData() took %" PRIu64 " ms [device %d]", __FUNCTION__, elapsed, deviceIdM);
@@ -319,169 +407,222 @@ void cSatipTuner::ProcessVideoData(u_char *bufferP, int lengthP)
   reConnectM.Set(eConnectTimeoutMs);
 }
 
+int cSatipTuner::Demux(cSatipDeviceIf &deviceP, const cSatipPidBitmap &bitmapP, u_char *bufferP, int lengthP, int *nullsP)
+{
+  // Write the wanted packets in as long runs as possible
+  int start = -1, i = 0, dropped = 0;
+  for (; i + TS_SIZE <= lengthP; i += TS_SIZE) {
+      // Unsynced data is passed as such for the device to resync
+      bool wanted = (bufferP[i] != TS_SYNC_BYTE);
+      if (!wanted) {
+         int pid = ts_pid(bufferP + i);
+         wanted = bitmapP.IsSet(pid);
+         if (!wanted) {
+            ++dropped;
+            if (nullsP && (pid == eNullPid))
+               ++*nullsP;
+            }
+         }
+      if (wanted) {
+         if (start < 0)
+            start = i;
+         }
+      else if (start >= 0) {
+         deviceP.WriteData(bufferP + start, i - start);
+         start = -1;
+         }
+      }
+  if (start >= 0)
+     deviceP.WriteData(bufferP + start, i - start);
+  return dropped;
+}
+
 void cSatipTuner::ProcessRtpData(u_char *bufferP, int lengthP)
 {
   rtpM.Process(bufferP, lengthP);
 }
 
-void cSatipTuner::ProcessApplicationData(u_char *bufferP, int lengthP)
+static int RtcpFieldToInt(std::string_view fieldP, int defaultP = 0)
+{
+  int value = 0;
+  bool negative = !fieldP.empty() && (fieldP.front() == '-');
+  if (negative)
+     fieldP.remove_prefix(1);
+  if (fieldP.empty())
+     return defaultP;
+  for (char c : fieldP) {
+      if ((c < '0') || (c > '9'))
+         break;
+      value = value * 10 + (c - '0');
+      }
+  return negative ? -value : value;
+}
+
+static double RtcpFieldToDouble(std::string_view fieldP)
+{
+  char buf[32];
+  size_t len = std::min(fieldP.size(), sizeof(buf) - 1);
+  memcpy(buf, fieldP.data(), len);
+  buf[len] = 0;
+  return strtod(buf, NULL);
+}
+
+void cSatipTuner::ProcessApplicationData(u_char *bufferP, int lengthP, bool fromRtcpP)
 {
-  dbg_funcname_ext("%s (%d) [device %d]", __PRETTY_FUNCTION__, lengthP, deviceIdM);
+  dbg_funcname_ext("%s (%d, %d) [device %d]", __PRETTY_FUNCTION__, lengthP, fromRtcpP, deviceIdM);
   reConnectM.Set(eConnectTimeoutMs);
 
   if (lengthP < 33) /* bare minimum. */
      return;
 
-  char s[lengthP+1];
-  memcpy(s, (char *)bufferP, lengthP);
-  s[lengthP] = 0;
-
-  char* ps = strstr(s, "ver=");
-  auto payload = SplitStr(ps, ';');
-
-  if (payload.size() < 3)
+  // DVB-S2: ver=1.0;src=<srcID>;tuner=<feID>,<level>,<lock>,<quality>,(..)
+  // DVB-T2: ver=1.1;tuner=<feID>,<level>,<lock>,<quality>,(..)
+  // DVB-C2: ver=1.2;tuner=<feID>,<level>,<lock>,<quality>,(..)
+  std::string_view data((const char *)bufferP, lengthP);
+  size_t pos = data.find("ver=");
+  if (pos == std::string_view::npos)
      return;
-
-  // DVB-S2: ver=1.0;src=<srcID>;(..)
-  // DVB-T2: ver=1.1;(..)
-  // DVB-C2: ver=1.2;(..)
-
-  bool isSat   = payload[0] == "ver=1.0";
-  bool isTerr  = payload[0] == "ver=1.1";
-  bool isCable = payload[0] == "ver=1.2";
-  size_t next = 1;
+  data.remove_prefix(pos);
+  // the string may be padded with NULs up to the next 32-bit boundary
+  pos = data.find('\0');
+  if (pos != std::string_view::npos)
+     data.remove_suffix(data.size() - pos);
+
+  auto NextToken = [](std::string_view &restP, char delimP) -> std::string_view {
+       size_t end = restP.find(delimP);
+       std::string_view token = restP.substr(0, end);
+       restP.remove_prefix((end == std::string_view::npos) ? restP.size() : end + 1);
+       return token;
+       };
+
+  std::string_view rest = data;
+  std::string_view version = NextToken(rest, ';');
+  bool isSat   = (version == "ver=1.0");
+  bool isTerr  = (version == "ver=1.1");
+  bool isCable = (version == "ver=1.2");
   int srcID = -1;
 
-  if (payload[next].find("src=") == 0)
-     srcID = StrToInt(payload[next++].substr(4));
-
-  // tuner=<feID>,<level>,<lock>,<quality>,(..)
-  auto params = SplitStr(payload[next++].substr(6), ',');
-  while(params.size() < 14)
-     params.push_back("");
-
-  dbg_rtcp("%s (%s) [device %d]", __PRETTY_FUNCTION__, ps, deviceIdM);
+  std::string_view token = NextToken(rest, ';');
+  if (token.substr(0, 4) == "src=") {
+     srcID = RtcpFieldToInt(token.substr(4), -1);
+     token = NextToken(rest, ';');
+     }
+  if (token.substr(0, 6) != "tuner=")
+     return;
+  token.remove_prefix(6);
+  // A valid report over RTCP makes a DESCRIBE needless for a while
+  if (fromRtcpP)
+     rtcpUpdateM.Set(eRtcpFreshnessTimeoutMs);
+
+  dbg_rtcp("%s (%.*s) [device %d]", __PRETTY_FUNCTION__, (int)data.size(), data.data(), deviceIdM);
+
+  // tuner=<feID>,<level>,<lock>,<quality>,<transponder data>
+  std::string_view params[eMaxRtcpTunerParams];
+  std::string_view transponder;
+  for (int i = 0; (i < eMaxRtcpTunerParams) && !token.empty(); ++i) {
+      if (i == 4)
+         transponder = token;
+      params[i] = NextToken(token, ',');
+      }
 
   // feID:
-  frontendIdM = StrToInt(params[0]);
+  frontendIdM = RtcpFieldToInt(params[0]);
 
   // level: 0..255
   // 224 corresponds to -25dBm
   //  32 corresponds to -65dBm
   //   0 corresponds to 'no signal' (dBm not available)
-  int level = StrToInt(params[1]);
+  int level = RtcpFieldToInt(params[1]);
   signalStrengthDBmM = (level > 0) ? 40.0 * (level - 32) / 192.0 - 65.0 : 0.0;
   // Scale value to 0-100
   signalStrengthM = (level >= 0) ? 0.5 + level * 100.0 / 255.0 : -1;
 
   // lock: "0" = not locked, "1" = locked
-  hasLockM = params[2] == "1";
+  SetLock(params[2] == "1");
 
   // quality: 0..15, lowest value corresponds to highest error rate
   // The value 15 shall correspond to
   // -a BER lower than 2x10-4 after Viterbi for DVB-S
   // -a PER lower than 10-7 for DVB-S2
-  int quality = StrToInt(params[3]);
+  int quality = RtcpFieldToInt(params[3]);
   // Scale value to 0-100
   signalQualityM = (hasLockM && (quality >= 0)) ? 0.5 + (quality * 100.0 / 15.0) : 0;
 
-  if (TP.size() == params.size()-4) {
-     bool equal = std::equal(params.begin()+4, params.end(), TP.begin());
-     if (equal)
-        return;
-     }
-  TP = {params.begin()+4, params.end()};
+  // Skip the transponder data unless it has changed since the last report (FNV-1a)
+  uint64_t hash = 14695981039346656037ULL;
+  for (char c : transponder) {
+      hash ^= (unsigned char)c;
+      hash *= 1099511628211ULL;
+      }
+  if (transponderHashM == hash)
+     return;
+  transponderHashM = hash;
 
   cChannel& channel = deviceM.currentChannel;
-  std::stringstream ss;
-
-  const bool DebugRtcp = false;
+  char parameters[64];
 
   if (isSat) {
      // <frequency>,<polarisation>,<system>,<type>,<pilots>,<roll_off>,<symbol_rate>,<fec_inner>
-     int  Frequency    = lround(StrToFloat(params[4]));                  // <frequency>,
-     char Polarisation = (UpperCase(params[5]))[0];                      // <polarisation>,
-     int  System       = SatipToVdrParameter("&msys=" + params[6]);      // <system>,
-     int  Type         = SatipToVdrParameter("&mtype=" + params[7]);     // <type>,
-     int  Pilots       = SatipToVdrParameter("&plts=" + params[8]);      // <pilots>,
-     int  RollOff      = SatipToVdrParameter("&ro=" + params[9]);        // <roll_off>,
-     int  SymbolRate   = params[10].empty()? 0 : StrToInt(params[10]);   // <symbol_rate>,
-     int  Fec          = SatipToVdrParameter("&fec=" + params[11]);      // <fec_inner>
+     int  Frequency    = lround(RtcpFieldToDouble(params[4]));              // <frequency>,
+     char Polarisation = params[5].empty() ? 'H' : toupper(params[5][0]);   // <polarisation>,
+     int  System       = SatipToVdrParameter("msys", params[6]);            // <system>,
+     int  Type         = SatipToVdrParameter("mtype", params[7]);           // <type>,
+     int  Pilots       = SatipToVdrParameter("plts", params[8]);            // <pilots>,
+     int  RollOff      = SatipToVdrParameter("ro", params[9]);              // <roll_off>,
+     int  SymbolRate   = RtcpFieldToInt(params[10]);                        // <symbol_rate>,
+     int  Fec          = SatipToVdrParameter("fec", params[11]);            // <fec_inner>
      int  Source       = SrcIdToSource(srcID);
 
      if (Source < 0)
         Source = channel.Source();
      if (SymbolRate <= 0)
         SymbolRate = channel.Srate();
-     ss << Polarisation;
-     ss << 'C' << Fec;
-     ss << 'M' << Type;
-     if (System > 0) {
-        ss << 'N' << Pilots;
-        ss << 'O' << RollOff;
-      //ss << 'P' << 999;
-        }
-     ss << 'S' << System;
-     if (DebugRtcp) {
-        std::cout << *(cSource::ToString(Source)) << ":"
-                  << Frequency << ":" << ss.str() << ":" << SymbolRate << std::endl;
-        }
-     channel.SetTransponderData(Source, Frequency, SymbolRate, ss.str().c_str(), true);
+     if (System > 0)
+        snprintf(parameters, sizeof(parameters), "%cC%dM%dN%dO%dS%d", Polarisation, Fec, Type, Pilots, RollOff, System);
+     else
+        snprintf(parameters, sizeof(parameters), "%cC%dM%dS%d", Polarisation, Fec, Type, System);
+     dbg_rtcp("%s [device %d] %s:%d:%s:%d", __PRETTY_FUNCTION__, deviceIdM, *cSource::ToString(Source), Frequency, parameters, SymbolRate);
+     channel.SetTransponderData(Source, Frequency, SymbolRate, parameters, true);
      }
   else if (isTerr) {
      // <freq>,<bw>,<msys>,<tmode>,<mtype>,<gi>,<fec>,<plp>,<t2id>,<sm>
-     int  Frequency    = lround(StrToFloat(params[4]));                  // <freq>,
-     int  BandWidth    = SatipToVdrParameter("&bw=" + params[5]);        // <bw>,
-     int  System       = SatipToVdrParameter("&msys=" + params[6]);      // <msys>,
-     int  Transmission = SatipToVdrParameter("&tmode=" + params[7]);     // <tmode>,
-     int  Type         = SatipToVdrParameter("&mtype=" + params[8]);     // <mtype>,
-     int  Guard        = SatipToVdrParameter("&gi=" + params[9]);        // <gi>,
-     int  Fec          = SatipToVdrParameter("&fec=" + params[10]);      // <fec>,
-     int  Plp          = params[11].empty()? -1 : StrToInt(params[11]);  // <plp> (opt),
-     int  T2id         = params[12].empty()? -1 : StrToInt(params[12]);  // <t2id> (opt),
-     int  SM           = SatipToVdrParameter("&sm=" + params[next++]);   // <sm> (opt)
-
-     ss << 'B' << BandWidth;
-     ss << 'C' << Fec;
-     ss << 'G' << Guard;
-     ss << 'M' << Type;
-     if (System > 0) {
-        ss << 'P' << Plp;
-        ss << 'Q' << T2id;
-        }
-     ss << 'S' << System;
-     ss << 'T' << Transmission;
-     if (System > 0) {
-        ss << 'X' << SM;
-        }
-
-     if (DebugRtcp) {
-        std::cout << Frequency << ":" << ss.str() << std::endl;
-        }
-     channel.SetTransponderData('T' << 24, Frequency, 0, ss.str().c_str(), true);
+     int  Frequency    = lround(RtcpFieldToDouble(params[4]));              // <freq>,
+     int  BandWidth    = SatipToVdrParameter("bw", params[5]);              // <bw>,
+     int  System       = SatipToVdrParameter("msys", params[6]);            // <msys>,
+     int  Transmission = SatipToVdrParameter("tmode", params[7]);           // <tmode>,
+     int  Type         = SatipToVdrParameter("mtype", params[8]);           // <mtype>,
+     int  Guard        = SatipToVdrParameter("gi", params[9]);              // <gi>,
+     int  Fec          = SatipToVdrParameter("fec", params[10]);            // <fec>,
+     int  Plp          = RtcpFieldToInt(params[11], -1);                    // <plp> (opt),
+     int  T2id         = RtcpFieldToInt(params[12], -1);                    // <t2id> (opt),
+     int  SM           = SatipToVdrParameter("sm", params[13]);             // <sm> (opt)
+
+     if (System > 0)
+        snprintf(parameters, sizeof(parameters), "B%dC%dG%dM%dP%dQ%dS%dT%dX%d", BandWidth, Fec, Guard, Type, Plp, T2id, System, Transmission, SM);
+     else
+        snprintf(parameters, sizeof(parameters), "B%dC%dG%dM%dS%dT%d", BandWidth, Fec, Guard, Type, System, Transmission);
+     dbg_rtcp("%s [device %d] %d:%s", __PRETTY_FUNCTION__, deviceIdM, Frequency, parameters);
+     channel.SetTransponderData(cSource::stTerr, Frequency, 0, parameters, true);
      }
   else if (isCable) {
      // <freq>,<bw>,<msys>,<mtype>,<sr>,<c2tft>,<ds>,<plp>,<specinv>
-     int  Frequency    = lround(StrToFloat(params[4]));                  // <freq>,
-   //int  BandWidth    = SatipToVdrParameter("&bw=" + params[5]);        // <bw> (opt),
-   //int  System       = SatipToVdrParameter("&msys=" + params[6]);      // <msys>,
-     int  Type         = SatipToVdrParameter("&mtype=" + params[7]);     // <mtype> (opt),
-     int  SymbolRate   = params[8].empty()? 0 : StrToInt(params[8]);     // <sr> (opt),
-   //int  C2tft        = params[9].empty()? 0 : StrToInt(params[9]);     // <c2tft> (opt),
-   //int  DS           = params[10].empty()? 0 : StrToInt(params[10]);   // <ds> (opt),
-   //int  Plp          = params[11].empty()? -1 : StrToInt(params[11]);  // <plp> (opt),
-     int  Inversion    = params[12].empty()? 999 : StrToInt(params[12]); // <specinv> (opt),
+     int  Frequency    = lround(RtcpFieldToDouble(params[4]));              // <freq>,
+   //int  BandWidth    = SatipToVdrParameter("bw", params[5]);              // <bw> (opt),
+   //int  System       = SatipToVdrParameter("msys", params[6]);            // <msys>,
+     int  Type         = SatipToVdrParameter("mtype", params[7]);           // <mtype> (opt),
+     int  SymbolRate   = RtcpFieldToInt(params[8]);                         // <sr> (opt),
+   //int  C2tft        = RtcpFieldToInt(params[9]);                         // <c2tft> (opt),
+   //int  DS           = RtcpFieldToInt(params[10]);                        // <ds> (opt),
+   //int  Plp          = RtcpFieldToInt(params[11], -1);                    // <plp> (opt),
+     int  Inversion    = RtcpFieldToInt(params[12], 999);                   // <specinv> (opt),
 
      if (SymbolRate <= 0)
         SymbolRate = channel.Srate();
-     ss << 'I' << Inversion;
-     ss << 'M' << Type;
+     snprintf(parameters, sizeof(parameters), "I%dM%d", Inversion, Type);
 
      // not used in VDR: BandWidth, System, C2tft, DS, Plp
-     if (DebugRtcp) {
-        std::cout << Frequency << ":" << ss.str() << ":" << SymbolRate << std::endl;
-        }
-     channel.SetTransponderData('C' << 24, Frequency, SymbolRate, ss.str().c_str(), true);
+     dbg_rtcp("%s [device %d] %d:%s:%d", __PRETTY_FUNCTION__, deviceIdM, Frequency, parameters, SymbolRate);
+     channel.SetTransponderData(cSource::stCable, Frequency, SymbolRate, parameters, true);
      }
 }
 
@@ -575,6 +716,7 @@ bool cSatipTuner::SetSource(cSatipServer *serverP, const int transponderP, const
            if (strcmp(*connectionUri, *lastAddrM))
               RequestState(tsRelease, smInternal);
            }
+        ResetContinuityStatistic();
         RequestState(tsSet, smExternal);
         setupTimeoutM.Set(eSetupTimeoutMs);
         }
@@ -587,37 +729,135 @@ bool cSatipTuner::SetSource(cSatipServer *serverP, const int transponderP, const
   return true;
 }
 
-bool cSatipTuner::SetPid(int pidP, int typeP, bool onP)
+bool cSatipTuner::IsPidUsed(int pidP)
+{
+  for (std::map<int, cSatipPid>::iterator it = ownerPidsM.begin(); it != ownerPidsM.end(); ++it) {
+      if (it->second.IndexOf(pidP) >= 0)
+         return true;
+      }
+  return false;
+}
+
+bool cSatipTuner::SetPid(int pidP, int typeP, bool onP, int ownerP)
 {
-  dbg_funcname_ext("%s (%d, %d, %d) [device %d]", __PRETTY_FUNCTION__, pidP, typeP, onP, deviceIdM);
+  dbg_funcname_ext("%s (%d, %d, %d, %d) [device %d]", __PRETTY_FUNCTION__, pidP, typeP, onP, ownerP, deviceIdM);
   cMutexLock MutexLock(&mutexM);
+  if (ownerP < 0)
+     ownerP = deviceIdM;
+  cSatipPid &owned = ownerPidsM[ownerP];
+  ownerBitmapsM[ownerP].Set(pidP, onP);
   if (onP) {
+     owned.AddPid(pidP);
+     if (!activePidsM.IsSet(pidP))
+        ResetContinuityStatistic(pidP);
      pidsM.AddPid(pidP);
+     activePidsM.Set(pidP, true);
      addPidsM.AddPid(pidP);
      delPidsM.RemovePid(pidP);
      }
   else {
-     pidsM.RemovePid(pidP);
-     delPidsM.AddPid(pidP);
-     addPidsM.RemovePid(pidP);
+     owned.RemovePid(pidP);
+     // The pid is removed from the stream only after its last user
+     if (!IsPidUsed(pidP)) {
+        pidsM.RemovePid(pidP);
+        activePidsM.Set(pidP, false);
+        delPidsM.AddPid(pidP);
+        addPidsM.RemovePid(pidP);
+        }
      }
-  dbg_pids("%s (%d, %d, %d) pids=%s [device %d]", __PRETTY_FUNCTION__, pidP, typeP, onP, *pidsM.ListPids(), deviceIdM);
-  sleepM.Signal();
+  dbg_pids("%s (%d, %d, %d, %d) pids=%s [device %d]", __PRETTY_FUNCTION__, pidP, typeP, onP, ownerP, *pidsM.ListPids(), deviceIdM);
+  Wakeup();
 
   return true;
 }
 
+void cSatipTuner::Subscribe(cSatipDeviceIf *deviceP)
+{
+  dbg_chan_switch("%s (%d) [device %d]", __PRETTY_FUNCTION__, deviceP->GetId(), deviceIdM);
+  cMutexLock MutexLock(&mutexM);
+  cSatipPidBitmap *bitmap = &ownerBitmapsM[deviceP->GetId()];
+  cMutexLock SubscribersLock(&subscribersMutexM);
+  if (subscribersM.IndexOf(deviceP) < 0) {
+     subscribersM.Append(deviceP);
+     subscriberBitmapsM.Append(bitmap);
+     }
+}
+
+void cSatipTuner::Unsubscribe(cSatipDeviceIf *deviceP)
+{
+  dbg_chan_switch("%s (%d) [device %d]", __PRETTY_FUNCTION__, deviceP->GetId(), deviceIdM);
+  subscribersMutexM.Lock();
+  int index = subscribersM.IndexOf(deviceP);
+  if (index >= 0) {
+     subscribersM.Remove(index);
+     subscriberBitmapsM.Remove(index);
+     }
+  subscribersMutexM.Unlock();
+  cMutexLock MutexLock(&mutexM);
+  // not referenced by the data path anymore
+  ownerBitmapsM.erase(deviceP->GetId());
+  std::map<int, cSatipPid>::iterator it = ownerPidsM.find(deviceP->GetId());
+  if (it != ownerPidsM.end()) {
+     std::vector<int> pids(it->second.Size());
+     for (int i = 0; i < it->second.Size(); ++i)
+         pids[i] = it->second[i];
+     ownerPidsM.erase(it);
+     for (auto pid : pids) {
+         if (!IsPidUsed(pid)) {
+            pidsM.RemovePid(pid);
+            activePidsM.Set(pid, false);
+            delPidsM.AddPid(pid);
+            addPidsM.RemovePid(pid);
+            }
+         }
+     Wakeup();
+     }
+}
+
+std::vector<int> cSatipTuner::GetPids(void)
+{
+  cMutexLock MutexLock(&mutexM);
+  std::vector<int> pids(pidsM.Size());
+  for (int i = 0; i < pidsM.Size(); ++i)
+      pids[i] = pidsM[i];
+  return pids;
+}
+
+int cSatipTuner::Subscribers(void)
+{
+  cMutexLock MutexLock(&subscribersMutexM);
+  return subscribersM.Size();
+}
+
+void cSatipTuner::Release(void)
+{
+  dbg_chan_switch("%s [device %d]", __PRETTY_FUNCTION__, deviceIdM);
+  cMutexLock MutexLock(&mutexM);
+  streamAddrM = "";
+  streamParamM = "";
+  RequestState(tsRelease, smExternal);
+}
+
 bool cSatipTuner::UpdatePids(bool forceP)
 {
   dbg_funcname_ext("%s (%d) tunerState=%s [device %d]", __PRETTY_FUNCTION__, forceP, TunerStateString(currentStateM), deviceIdM);
   cMutexLock MutexLock(&mutexM);
-  if (((forceP && pidsM.Size()) || (pidUpdateCacheM.TimedOut() && (addPidsM.Size() || delPidsM.Size()))) &&
+  if (((forceP && (pidsM.Size() || currentServerM.IsQuirk(cSatipServer::eSatipQuirkFullMux))) || (pidUpdateCacheM.TimedOut() && (addPidsM.Size() || delPidsM.Size()))) &&
       !isempty(*streamAddrM) && (streamIdM >= 0)) {
      cString uri = cString::sprintf("%sstream=%d", *GetBaseUrl(*streamAddrM, streamPortM), streamIdM);
      bool useci = (SatipConfig.GetCIExtension() && currentServerM.HasCI());
      bool usedummy = currentServerM.IsQuirk(cSatipServer::eSatipQuirkPlayPids);
      bool paramadded = false;
-     if (forceP || usedummy) {
+     if (forceP)
+        fullMuxM = currentServerM.IsQuirk(cSatipServer::eSatipQuirkFullMux);
+     if (fullMuxM) {
+        // The pids are filtered locally, so only the initial request is needed
+        if (forceP) {
+           uri = cString::sprintf("%s%spids=all", *uri, paramadded ? "&" : "?");
+           paramadded = true;
+           }
+        }
+     else if (forceP || usedummy) {
         if (pidsM.Size()) {
            uri = cString::sprintf("%s%spids=%s", *uri, paramadded ? "&" : "?", *pidsM.ListPids());
            if (usedummy && (pidsM.Size() == 1) && (pidsM[0] < 0x20))
@@ -665,7 +905,7 @@ bool cSatipTuner::UpdatePids(bool forceP)
            }
         }
      pidUpdateCacheM.Set(ePidUpdateIntervalMs);
-     if (!rtspM.Play(*uri))
+     if ((forceP || paramadded || !fullMuxM) && !rtspM.Play(*uri))
         return false;
      addPidsM.Clear();
      delPidsM.Clear();
@@ -712,7 +952,13 @@ bool cSatipTuner::ReadReceptionStatus(bool forceP)
      statusUpdateM.Set(eStatusUpdateTimeoutMs);
      forceP = true;
      }
+  // RTCP reports carry the same tuner data as DESCRIBE, so use it while it keeps coming
+  if (forceP && !rtcpUpdateM.TimedOut()) {
+     currentServerM.CountDescribe(true);
+     return true;
+     }
   if (forceP && !isempty(*streamAddrM) && (streamIdM >= 0)) {
+     currentServerM.CountDescribe(false);
      cString uri = cString::sprintf("%sstream=%d", *GetBaseUrl(*streamAddrM, streamPortM), streamIdM);
      if (rtspM.Describe(*uri))
         return true;
@@ -739,6 +985,9 @@ void cSatipTuner::UpdateCurrentState(void)
   if (currentStateM != state) {
      dbg_funcname("%s: Switching from %s to %s [device %d]", __PRETTY_FUNCTION__, TunerStateString(currentStateM), TunerStateString(state), deviceIdM);
      currentStateM = state;
+     // HasLock() depends on the state as well
+     cMutexLock LockMutexLock(&lockMutexM);
+     lockChangedM.Broadcast();
      }
 }
 
@@ -845,6 +1094,37 @@ bool cSatipTuner::HasLock(void)
   return (currentStateM >= tsTuned) && hasLockM;
 }
 
+void cSatipTuner::SetLock(bool onP)
+{
+  // Waiters check the lock state while holding lockMutexM, so updating and
+  // signalling it under the same mutex can't lose a wakeup.
+  cMutexLock MutexLock(&lockMutexM);
+  if (hasLockM != onP) {
+     hasLockM = onP;
+     lockChangedM.Broadcast();
+     }
+}
+
+bool cSatipTuner::WaitLock(int timeoutMsP)
+{
+  dbg_funcname_ext("%s (%d) [device %d]", __PRETTY_FUNCTION__, timeoutMsP, deviceIdM);
+  cMutexLock MutexLock(&lockMutexM);
+  if (HasLock())
+     return true;
+  auto start = std::chrono::steady_clock::now();
+  long waited = 0; // in microseconds
+  bool locked;
+  while (!(locked = HasLock())) {
+        int remaining = timeoutMsP - (int)(waited / 1000);
+        if (remaining <= 0)
+           break;
+        lockChangedM.TimedWait(lockMutexM, remaining);
+        waited = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        }
+  AddLockWaitStatistic(waited, locked);
+  return locked;
+}
+
 cString cSatipTuner::GetSignalStatus(void)
 {
   dbg_funcname_ext("%s [device %d]", __PRETTY_FUNCTION__, deviceIdM);
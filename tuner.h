@@ -8,12 +8,16 @@
 #ifndef __SATIP_TUNER_H
 #define __SATIP_TUNER_H
 
+#include <atomic>
+#include <map>
 #include <string>
 #include <vector>
 #include <vdr/thread.h>
 #include <vdr/tools.h>
 
+#include "deviceif.h"
 #include "discover.h"
+#include "eventloopif.h"
 #include "rtp.h"
 #include "rtcp.h"
 #include "rtsp.h"
@@ -22,9 +26,35 @@
 
 /* forward declarations */
 class cSatipDevice;
+class cSatipEventLoop;
 
 
 
+// Lock-free pid lookup for the data path, updated along with cSatipPid.
+class cSatipPidBitmap {
+private:
+  std::atomic<uint64_t> bitsM[8192 / 64];
+
+public:
+  cSatipPidBitmap() { Clear(); }
+  void Clear(void)
+  {
+    for (unsigned int i = 0; i < ELEMENTS(bitsM); ++i)
+        bitsM[i].store(0, std::memory_order_relaxed);
+  }
+  void Set(int pidP, bool onP)
+  {
+    if (onP)
+       bitsM[(pidP >> 6) & 0x7F].fetch_or(1ULL << (pidP & 0x3F), std::memory_order_relaxed);
+    else
+       bitsM[(pidP >> 6) & 0x7F].fetch_and(~(1ULL << (pidP & 0x3F)), std::memory_order_relaxed);
+  }
+  bool IsSet(int pidP) const
+  {
+    return bitsM[(pidP >> 6) & 0x7F].load(std::memory_order_relaxed) & (1ULL << (pidP & 0x3F));
+  }
+};
+
 class cSatipPid : public cVector<int> {
 private:
   static int PidCompare(const void *aPidP, const void *bPidP)
@@ -70,6 +100,8 @@ public:
   bool IsValid(void) { return !!serverM; }
   bool IsQuirk(int quirkP) { return (serverM && cSatipDiscover::GetInstance()->IsServerQuirk(serverM, quirkP)); }
   bool HasCI(void) { return (serverM && cSatipDiscover::GetInstance()->HasServerCI(serverM)); }
+  void CountDescribe(bool avoidedP) { if (serverM) cSatipDiscover::GetInstance()->CountServerDescribe(serverM, avoidedP); }
+  void AddTraffic(long bytesP) { if (serverM) cSatipDiscover::GetInstance()->AddServerTraffic(serverM, bytesP); }
   void Attach(void) { if (serverM) cSatipDiscover::GetInstance()->AttachServer(serverM, deviceIdM, transponderM); }
   void Detach(void) { if (serverM) cSatipDiscover::GetInstance()->DetachServer(serverM, deviceIdM, transponderM); }
   void Set(cSatipServer *serverP, const int transponderP) { serverM = serverP; transponderM = transponderP; }
@@ -80,16 +112,20 @@ public:
   cString GetInfo(void) { return cString::sprintf("server=%s deviceid=%d transponder=%d", serverM ? "assigned" : "null", deviceIdM, transponderM); }
 };
 
-class cSatipTuner : public cThread, public cSatipTunerStatistics, public cSatipTunerIf
+class cSatipTuner : public cThread, public cSatipTunerStatistics, public cSatipContinuityStatistics, public cSatipTunerIf, public cSatipEventLoopIf
 {
 private:
   enum {
     eDummyPid                 = 100,
+    eNullPid                  = 0x1FFF,
+    eMaxRtcpTunerParams       = 14,
     eDefaultSignalStrengthDBm = -25,
     eDefaultSignalStrength    = 224,
     eDefaultSignalQuality     = 15,
     eSleepTimeoutMs           = 250,   // in milliseconds
     eStatusUpdateTimeoutMs    = 1000,  // in milliseconds
+    eRtcpFreshnessTimeoutMs   = 2000,  // in milliseconds
+    eTrafficReportIntervalMs  = 1000,  // in milliseconds
     ePidUpdateIntervalMs      = 250,   // in milliseconds
     eConnectTimeoutMs         = 5000,  // in milliseconds
     eIdleCheckTimeoutMs       = 15000, // in milliseconds
@@ -116,9 +152,22 @@ private:
   cSatipTunerServer currentServerM;
   cSatipTunerServer nextServerM;
   cMutex mutexM;
+  cMutex lockMutexM;
+  cCondVar lockChangedM;
+  cMutex subscribersMutexM;
+  cVector<cSatipDeviceIf *> subscribersM;
+  cVector<cSatipPidBitmap *> subscriberBitmapsM;
+  std::atomic<bool> fullMuxM;
   cTimeMs reConnectM;
+  cTimeMs idleCheckM;
+  cTimeMs tuningM;
+  bool lastIdleStatusM;
+  cSatipEventLoop *loopM;
+  cTimeMs trafficReportM;
+  std::atomic<long> trafficM;
   cTimeMs keepAliveM;
   cTimeMs statusUpdateM;
+  cTimeMs rtcpUpdateM;
   cTimeMs pidUpdateCacheM;
   cTimeMs setupTimeoutM;
   cString sessionM;
@@ -136,7 +185,14 @@ private:
   cSatipPid addPidsM;
   cSatipPid delPidsM;
   cSatipPid pidsM;
-  std::vector<std::string> TP;
+  // pids requested by this device and by each subscribed device
+  std::map<int, cSatipPid> ownerPidsM;
+  std::map<int, cSatipPidBitmap> ownerBitmapsM;
+  cSatipPidBitmap *hostBitmapM;
+  // the requested pids of all owners
+  cSatipPidBitmap activePidsM;
+  uint64_t transponderHashM;
+  bool activeM;
 
   bool Connect(void);
   bool Disconnect(void);
@@ -144,6 +200,9 @@ private:
   bool KeepAlive(bool forceP = false);
   bool ReadReceptionStatus(bool forceP = false);
   bool UpdatePids(bool forceP = false);
+  bool IsPidUsed(int pidP);
+  int Demux(cSatipDeviceIf &deviceP, const cSatipPidBitmap &bitmapP, u_char *bufferP, int lengthP, int *nullsP = NULL);
+  void SetLock(bool onP);
   void UpdateCurrentState(void);
   bool StateRequested(void);
   bool RequestState(eTunerState stateP, eStateMode modeP);
@@ -158,8 +217,18 @@ public:
   cSatipTuner(cSatipDevice& deviceP, unsigned int packetLenP);
   virtual ~cSatipTuner();
   bool IsTuned(void) const { return (currentStateM >= tsTuned); }
+  bool IsIdle(void) { return (currentStateM == tsIdle) && !StateRequested(); }
+  // open and close the sockets and the thread, serialized by the device
+  bool Activate(void);
+  void Deactivate(void);
   bool SetSource(cSatipServer *serverP, const int transponderP, const char *parameterP, const int indexP);
-  bool SetPid(int pidP, int typeP, bool onP);
+  bool SetPid(int pidP, int typeP, bool onP, int ownerP = -1);
+  void Subscribe(cSatipDeviceIf *deviceP);
+  void Unsubscribe(cSatipDeviceIf *deviceP);
+  std::vector<int> GetPids(void);
+  int Subscribers(void);
+  void Release(void);
+  void Wakeup(void);
   bool Open(void);
   bool Close(void);
   int FrontendId(void);
@@ -167,19 +236,25 @@ public:
   double SignalStrengthDBm(void);
   int SignalQuality(void);
   bool HasLock(void);
+  bool WaitLock(int timeoutMsP);
   cString GetSignalStatus(void);
   cString GetInformation(void);
 
   // for internal tuner interface
 public:
   virtual void ProcessVideoData(u_char *bufferP, int lengthP);
-  virtual void ProcessApplicationData(u_char *bufferP, int lengthP);
+  virtual void ProcessApplicationData(u_char *bufferP, int lengthP, bool fromRtcpP);
   virtual void ProcessRtpData(u_char *bufferP, int lengthP);
   virtual void ProcessRtcpData(u_char *bufferP, int lengthP);
   virtual void SetStreamId(int streamIdP);
   virtual void SetSessionTimeout(const char *sessionP, int timeoutP);
   virtual void SetupTransport(int rtpPortP, int rtcpPortP, const char *streamAddrP, const char *sourceAddrP);
   virtual int GetId(void);
+
+  // for internal event loop interface
+public:
+  virtual int RunOnce(void);
+  virtual cString ToString(void) const;
 };
 
 #endif // __SATIP_TUNER_H
@@ -13,7 +13,7 @@ public:
   cSatipTunerIf() {}
   virtual ~cSatipTunerIf() {}
   virtual void ProcessVideoData(u_char *bufferP, int lengthP) = 0;
-  virtual void ProcessApplicationData(u_char *bufferP, int lengthP) = 0;
+  virtual void ProcessApplicationData(u_char *bufferP, int lengthP, bool fromRtcpP) = 0;
   virtual void ProcessRtpData(u_char *bufferP, int lengthP) = 0;
   virtual void ProcessRtcpData(u_char *bufferP, int lengthP) = 0;
   virtual void SetStreamId(int streamIdP) = 0;